@@ -0,0 +1,355 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_atom_hpp_
+#define indigo_atom_hpp_
+
+// Required libraries
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <functional>
+#include <stdint.h>
+
+namespace indigo
+{
+	class AtomTable;
+
+	// An interned string. Every distinct string maps to exactly one atom for the
+	// lifetime of the process, so comparing atoms compares pointers, and the hash
+	// and length are computed once when the string is first interned. Atoms also
+	// have a dense 32-bit id that can be stored and turned back into the atom.
+	// The default atom is the empty string.
+	// Example:
+	//    static const Atom kContentType("Content-Type");
+	//    ...
+	//    if (Atom(name) == kContentType)
+	//        ...
+	class Atom
+	{
+		friend class AtomTable;
+
+	public:
+		struct Entry
+		{
+			uint64_t Hash;
+			uint32_t Id;
+			uint32_t Length;
+			// Null-terminated, stored right behind the entry
+			const char *Data;
+		};
+
+	private:
+		const Entry *mEntry;
+
+		explicit Atom(const Entry *entry) : mEntry(entry) { }
+
+		// FNV-1a, cheap enough for the short strings atoms are made of
+		static uint64_t hash(std::string_view string)
+		{
+			uint64_t hash = 0xCBF29CE484222325;
+			for (char character : string)
+			{
+				hash ^= static_cast<uint8_t>(character);
+				hash *= 0x00000100000001B3;
+			}
+
+			return hash;
+		}
+
+	public:
+		Atom() : mEntry(nullptr) { }
+
+		// Interns the string, adding it to the table the first time it is seen.
+		// Throws std::length_error when all 2^24 - 1 ids are taken.
+		explicit Atom(std::string_view string);
+
+		// Looks the string up without adding it. Existing atoms are found without
+		// taking a lock.
+		static bool Find(std::string_view string, Atom &atom);
+
+		// The atom with the given id, or the empty atom if there is none
+		static Atom FromId(uint32_t id);
+
+		std::string_view GetString() const
+		{
+			return mEntry != nullptr ? std::string_view(mEntry->Data, mEntry->Length) : std::string_view();
+		}
+
+		const char *GetCString() const
+		{
+			return mEntry != nullptr ? mEntry->Data : "";
+		}
+
+		size_t GetLength() const
+		{
+			return mEntry != nullptr ? mEntry->Length : 0;
+		}
+
+		// The empty atom has id 0
+		uint32_t GetId() const
+		{
+			return mEntry != nullptr ? mEntry->Id : 0;
+		}
+
+		uint64_t GetHash() const
+		{
+			static const uint64_t emptyHash = hash(std::string_view());
+			return mEntry != nullptr ? mEntry->Hash : emptyHash;
+		}
+
+		bool IsEmpty() const
+		{
+			return mEntry == nullptr;
+		}
+
+		bool operator==(const Atom &other) const
+		{
+			return mEntry == other.mEntry;
+		}
+
+		bool operator!=(const Atom &other) const
+		{
+			return mEntry != other.mEntry;
+		}
+
+		// Orders by id, i.e. by when the atoms were first interned, not alphabetically
+		bool operator<(const Atom &other) const
+		{
+			return GetId() < other.GetId();
+		}
+	};
+
+	// The process-wide table behind Atom. Lookups probe an open-addressing table of
+	// atomic pointers without locking; only adding a new string takes the mutex.
+	// When the table grows, the old one is kept so readers still probing it stay
+	// safe. Entries live in an arena and are never freed.
+	class AtomTable
+	{
+		struct Table
+		{
+			size_t Mask;
+			std::unique_ptr<std::atomic<const Atom::Entry *>[]> Slots;
+
+			explicit Table(size_t capacity) : Mask(capacity - 1), Slots(new std::atomic<const Atom::Entry *>[capacity])
+			{
+				for (size_t i = 0; i < capacity; i++)
+					Slots[i].store(nullptr, std::memory_order_relaxed);
+			}
+		};
+
+		static const size_t kInitialCapacity = 1024;
+		static const size_t kBlockSize = 64 * 1024;
+		// Ids are looked up in segments, so they can be added without moving the
+		// ones readers may be looking at
+		static const uint32_t kSegmentBits = 12;
+		static const uint32_t kSegmentSize = 1 << kSegmentBits;
+		static const uint32_t kMaxSegments = 4096;
+
+		std::mutex mMutex;
+		std::atomic<Table *> mTable;
+		std::vector<std::unique_ptr<Table>> mTables;
+		uint32_t mCount;
+
+		std::vector<std::unique_ptr<char[]>> mBlocks;
+		char *mCursor;
+		size_t mRemaining;
+
+		std::atomic<std::atomic<const Atom::Entry *> *> mSegments[kMaxSegments];
+		std::vector<std::unique_ptr<std::atomic<const Atom::Entry *>[]>> mSegmentStorage;
+
+		AtomTable() : mCount(0), mCursor(nullptr), mRemaining(0)
+		{
+			mTables.emplace_back(new Table(kInitialCapacity));
+			mTable.store(mTables.back().get(), std::memory_order_relaxed);
+
+			for (auto &segment : mSegments)
+				segment.store(nullptr, std::memory_order_relaxed);
+		}
+
+		static const Atom::Entry *find(const Table &table, std::string_view string, uint64_t hash)
+		{
+			for (size_t index = static_cast<size_t>(hash) & table.Mask;; index = (index + 1) & table.Mask)
+			{
+				const Atom::Entry *entry = table.Slots[index].load(std::memory_order_acquire);
+				if (entry == nullptr)
+					return nullptr;
+
+				if (entry->Hash == hash && entry->Length == string.size() && memcmp(entry->Data, string.data(), string.size()) == 0)
+					return entry;
+			}
+		}
+
+		static void insert(Table &table, const Atom::Entry *entry)
+		{
+			size_t index = static_cast<size_t>(entry->Hash) & table.Mask;
+			while (table.Slots[index].load(std::memory_order_relaxed) != nullptr)
+				index = (index + 1) & table.Mask;
+
+			table.Slots[index].store(entry, std::memory_order_release);
+		}
+
+		void *allocate(size_t size)
+		{
+			size = (size + alignof(Atom::Entry) - 1) & ~(alignof(Atom::Entry) - 1);
+			if (size > mRemaining)
+			{
+				const size_t blockSize = size > kBlockSize ? size : kBlockSize;
+				mBlocks.emplace_back(new char[blockSize]);
+				mCursor = mBlocks.back().get();
+				mRemaining = blockSize;
+			}
+
+			void *result = mCursor;
+			mCursor += size;
+			mRemaining -= size;
+			return result;
+		}
+
+		// Takes the mutex, and adds the string unless another thread got there first
+		const Atom::Entry *add(std::string_view string, uint64_t hash)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			Table *table = mTable.load(std::memory_order_relaxed);
+			if (const Atom::Entry *entry = find(*table, string, hash))
+				return entry;
+
+			// Ids start at 1, 0 is the empty atom
+			const uint32_t id = mCount + 1;
+			if ((id >> kSegmentBits) >= kMaxSegments)
+				throw std::length_error("Atom ids exhausted");
+
+			// Keep the table at most half full so probes stay short
+			if ((mCount + 1) * 2 > table->Mask + 1)
+			{
+				std::unique_ptr<Table> grown(new Table((table->Mask + 1) * 2));
+				for (size_t i = 0; i <= table->Mask; i++)
+					if (const Atom::Entry *entry = table->Slots[i].load(std::memory_order_relaxed))
+						insert(*grown, entry);
+
+				table = grown.get();
+				mTables.push_back(std::move(grown));
+				mTable.store(table, std::memory_order_release);
+			}
+
+			auto *entry = static_cast<Atom::Entry *>(allocate(sizeof(Atom::Entry) + string.size() + 1));
+			char *data = reinterpret_cast<char *>(entry + 1);
+			memcpy(data, string.data(), string.size());
+			data[string.size()] = '\0';
+
+			entry->Hash = hash;
+			entry->Id = id;
+			entry->Length = static_cast<uint32_t>(string.size());
+			entry->Data = data;
+
+			auto *segment = mSegments[id >> kSegmentBits].load(std::memory_order_relaxed);
+			if (segment == nullptr)
+			{
+				mSegmentStorage.emplace_back(new std::atomic<const Atom::Entry *>[kSegmentSize]);
+				segment = mSegmentStorage.back().get();
+				for (uint32_t i = 0; i < kSegmentSize; i++)
+					segment[i].store(nullptr, std::memory_order_relaxed);
+
+				mSegments[id >> kSegmentBits].store(segment, std::memory_order_release);
+			}
+
+			segment[id & (kSegmentSize - 1)].store(entry, std::memory_order_release);
+			insert(*table, entry);
+			mCount++;
+
+			return entry;
+		}
+
+	public:
+		// Never destroyed, so atoms stay valid in static destructors
+		static AtomTable &GetInstance()
+		{
+			static AtomTable *instance = new AtomTable();
+			return *instance;
+		}
+
+		AtomTable(const AtomTable &) = delete;
+		AtomTable &operator=(const AtomTable &) = delete;
+
+		Atom Intern(std::string_view string)
+		{
+			if (string.empty())
+				return Atom();
+
+			const uint64_t hash = Atom::hash(string);
+			if (const Atom::Entry *entry = find(*mTable.load(std::memory_order_acquire), string, hash))
+				return Atom(entry);
+
+			return Atom(add(string, hash));
+		}
+
+		bool Find(std::string_view string, Atom &atom)
+		{
+			if (string.empty())
+			{
+				atom = Atom();
+				return true;
+			}
+
+			const Atom::Entry *entry = find(*mTable.load(std::memory_order_acquire), string, Atom::hash(string));
+			if (entry == nullptr)
+				return false;
+
+			atom = Atom(entry);
+			return true;
+		}
+
+		Atom FromId(uint32_t id)
+		{
+			if ((id >> kSegmentBits) >= kMaxSegments)
+				return Atom();
+
+			auto *segment = mSegments[id >> kSegmentBits].load(std::memory_order_acquire);
+			return Atom(segment != nullptr ? segment[id & (kSegmentSize - 1)].load(std::memory_order_acquire) : nullptr);
+		}
+
+		// Number of atoms, not counting the empty one
+		size_t GetCount()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mCount;
+		}
+	};
+
+	inline Atom::Atom(std::string_view string) : Atom(AtomTable::GetInstance().Intern(string)) { }
+
+	inline bool Atom::Find(std::string_view string, Atom &atom)
+	{
+		return AtomTable::GetInstance().Find(string, atom);
+	}
+
+	inline Atom Atom::FromId(uint32_t id)
+	{
+		return AtomTable::GetInstance().FromId(id);
+	}
+}
+
+namespace std
+{
+	template <>
+	struct hash<indigo::Atom>
+	{
+		size_t operator()(const indigo::Atom &atom) const
+		{
+			return static_cast<size_t>(atom.GetHash());
+		}
+	};
+}
+
+#endif // indigo_atom_hpp_
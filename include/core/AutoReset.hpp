@@ -0,0 +1,55 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_auto_reset_hpp_
+#define indigo_auto_reset_hpp_
+
+#include "WaitHandle.hpp"
+
+namespace indigo
+{
+	// Releases a single waiter per Set and resets itself as that waiter returns.
+	// Setting it while nobody waits keeps it signaled for the next waiter.
+	class AutoReset : public WaitHandle
+	{
+	protected:
+		bool consume(bool othersWaiting) override
+		{
+			uint32_t signaled = kState_Signaled;
+			return mState.compare_exchange_strong(signaled, othersWaiting ? kState_Waiting : kState_Unsignaled, std::memory_order_acq_rel);
+		}
+
+		void release() override
+		{
+			signal(false);
+		}
+
+	public:
+		explicit AutoReset(bool initialState = false)
+			: WaitHandle(initialState) { }
+
+		void Set()
+		{
+			signal(false);
+		}
+
+		void Reset()
+		{
+			uint32_t signaled = kState_Signaled;
+			mState.compare_exchange_strong(signaled, kState_Unsignaled, std::memory_order_acq_rel);
+		}
+
+		// Timeout in milliseconds, 0 waits forever. Returns false if the timeout expired.
+		bool Wait(int timeout = 0)
+		{
+			return wait(timeout);
+		}
+	};
+}
+
+#endif // indigo_auto_reset_hpp_
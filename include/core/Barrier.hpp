@@ -0,0 +1,70 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_barrier_hpp_
+#define indigo_barrier_hpp_
+
+#include "Futex.hpp"
+
+namespace indigo
+{
+	// Reusable rendezvous for a fixed number of threads. Every phase ends when the
+	// last thread arrives, which releases the others and resets the barrier.
+	class Barrier
+	{
+		static const uint32_t kSpin = 256;
+
+		const uint32_t mCount;
+		std::atomic<uint32_t> mRemaining;
+
+		// Bumped at the end of every phase, waiters park on it
+		std::atomic<uint32_t> mPhase;
+
+	public:
+		explicit Barrier(uint32_t count)
+			: mCount(count), mRemaining(count), mPhase(0) { }
+
+		Barrier(const Barrier &) = delete;
+		Barrier &operator=(const Barrier &) = delete;
+
+		// Returns true for exactly one thread per phase, the one that arrived last
+		bool ArriveAndWait()
+		{
+			const uint32_t phase = mPhase.load(std::memory_order_acquire);
+			if (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				// Nobody can arrive for the next phase before the phase changes
+				mRemaining.store(mCount, std::memory_order_relaxed);
+				mPhase.fetch_add(1, std::memory_order_release);
+				Futex::WakeAll(mPhase);
+				return true;
+			}
+
+			const uint32_t spin = Futex::GetSpinCount(kSpin);
+			for (uint32_t i = 0; i < spin; i++)
+			{
+				if (mPhase.load(std::memory_order_acquire) != phase)
+					return false;
+
+				Futex::Pause();
+			}
+
+			while (mPhase.load(std::memory_order_acquire) == phase)
+				Futex::Wait(mPhase, phase);
+
+			return false;
+		}
+
+		uint32_t GetCount() const
+		{
+			return mCount;
+		}
+	};
+}
+
+#endif // indigo_barrier_hpp_
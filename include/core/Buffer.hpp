@@ -11,6 +11,7 @@
 
 // Required libraries
 #include <vector>
+#include <stddef.h>
 #include <stdint.h>
 
 namespace indigo
@@ -197,7 +198,7 @@ namespace indigo
 			mBuffer.resize(size);
 		}
 
-		const size_t &GetSize() const
+		size_t GetSize() const
 		{
 			return mBuffer.size();
 		}
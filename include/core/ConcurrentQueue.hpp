@@ -0,0 +1,157 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_concurrent_queue_hpp_
+#define indigo_concurrent_queue_hpp_
+
+// Required libraries
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+namespace indigo
+{
+	// Bounded lock-free queue for any number of producers and consumers. Every cell
+	// carries a sequence number that tells producers and consumers whose turn it
+	// is, so pushing and popping only take a single compare-and-swap.
+	// Example:
+	//    ConcurrentQueue<int> queue(1024);
+	//    queue.TryPush(5);
+	//    ...
+	//    int value;
+	//    while (queue.TryPop(value))
+	//        printf("%i\n", value);
+	template <typename _TValue>
+	class ConcurrentQueue
+	{
+		struct Cell
+		{
+			std::atomic<size_t> Sequence;
+			typename std::aligned_storage<sizeof(_TValue), alignof(_TValue)>::type Storage;
+		};
+
+		std::unique_ptr<Cell[]> mCells;
+		size_t mMask;
+
+		// Producers and consumers each get their own cache line
+		alignas(64) std::atomic<size_t> mEnqueuePosition;
+		alignas(64) std::atomic<size_t> mDequeuePosition;
+
+	public:
+		// The capacity is rounded up to the next power of two
+		explicit ConcurrentQueue(size_t capacity)
+			: mEnqueuePosition(0), mDequeuePosition(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			mCells.reset(new Cell[size]);
+			mMask = size - 1;
+			for (size_t i = 0; i < size; i++)
+				mCells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+
+		ConcurrentQueue(const ConcurrentQueue &) = delete;
+		ConcurrentQueue &operator=(const ConcurrentQueue &) = delete;
+
+		~ConcurrentQueue()
+		{
+			size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+			for (;; position++)
+			{
+				Cell &cell = mCells[position & mMask];
+				if (cell.Sequence.load(std::memory_order_relaxed) != position + 1)
+					break;
+
+				reinterpret_cast<_TValue *>(&cell.Storage)->~_TValue();
+			}
+		}
+
+		template <typename _TInput>
+		bool TryPush(_TInput &&value)
+		{
+			Cell *cell;
+			size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &mCells[position & mMask];
+				const size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+				const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+				if (difference == 0)
+				{
+					if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0)
+				{
+					// Full
+					return false;
+				}
+				else
+				{
+					position = mEnqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			new (&cell->Storage) _TValue(std::forward<_TInput>(value));
+			cell->Sequence.store(position + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		bool TryPop(_TValue &value)
+		{
+			Cell *cell;
+			size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &mCells[position & mMask];
+				const size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+				const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+				if (difference == 0)
+				{
+					if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0)
+				{
+					// Empty
+					return false;
+				}
+				else
+				{
+					position = mDequeuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			_TValue *stored = reinterpret_cast<_TValue *>(&cell->Storage);
+			value = std::move(*stored);
+			stored->~_TValue();
+			cell->Sequence.store(position + mMask + 1, std::memory_order_release);
+
+			return true;
+		}
+
+		// Only a snapshot; other threads may push or pop at any time
+		bool IsEmpty() const
+		{
+			return mDequeuePosition.load(std::memory_order_seq_cst) == mEnqueuePosition.load(std::memory_order_seq_cst);
+		}
+
+		size_t GetCapacity() const
+		{
+			return mMask + 1;
+		}
+	};
+}
+
+#endif // indigo_concurrent_queue_hpp_
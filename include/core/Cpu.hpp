@@ -0,0 +1,144 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_cpu_hpp_
+#define indigo_cpu_hpp_
+
+#include <stdint.h>
+
+// SSE2 is part of every x64 target, so it can be used without checking the CPU
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INDIGO_SSE2
+#include <emmintrin.h>
+#endif
+
+// Newer instruction sets are compiled per function and only called after
+// checking the CPU at runtime. MSVC accepts the intrinsics without a flag.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define INDIGO_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define INDIGO_TARGET(features)
+#else
+#define INDIGO_TARGET(features) __attribute__((target(features)))
+#endif
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(INDIGO_X86)
+#include <cpuid.h>
+#endif
+
+namespace indigo
+{
+	// Instruction sets available on the running CPU, detected once
+	class Cpu
+	{
+	public:
+		enum Feature : uint32_t
+		{
+			kFeature_Sse2 = 1 << 0,
+			kFeature_Ssse3 = 1 << 1,
+			kFeature_Sse41 = 1 << 2,
+			kFeature_Sse42 = 1 << 3,
+			kFeature_Pclmul = 1 << 4,
+			kFeature_Avx = 1 << 5,
+			kFeature_Avx2 = 1 << 6,
+			kFeature_Bmi2 = 1 << 7,
+			kFeature_Sha = 1 << 8
+		};
+
+	private:
+#if defined(INDIGO_X86)
+		static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+		{
+#if defined(_MSC_VER)
+			int values[4];
+			__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+			for (int i = 0; i < 4; i++)
+				registers[i] = static_cast<uint32_t>(values[i]);
+#else
+			__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		}
+
+		// Whether the OS saves the YMM registers on context switches
+		static bool isAvxEnabled()
+		{
+#if defined(_MSC_VER)
+			return (_xgetbv(0) & 6) == 6;
+#else
+			uint32_t low, high;
+			__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (low & 6) == 6;
+#endif
+		}
+#endif
+
+		static uint32_t detect()
+		{
+			uint32_t features = 0;
+#if defined(INDIGO_X86)
+			uint32_t registers[4];
+			cpuid(0, 0, registers);
+			const uint32_t maximumLeaf = registers[0];
+			if (maximumLeaf < 1)
+				return features;
+
+			cpuid(1, 0, registers);
+			const uint32_t ecx = registers[2], edx = registers[3];
+			if (edx & (1 << 26)) features |= kFeature_Sse2;
+			if (ecx & (1 << 9)) features |= kFeature_Ssse3;
+			if (ecx & (1 << 19)) features |= kFeature_Sse41;
+			if (ecx & (1 << 20)) features |= kFeature_Sse42;
+			if (ecx & (1 << 1)) features |= kFeature_Pclmul;
+
+			const bool avx = (ecx & (1 << 28)) && (ecx & (1 << 27)) && isAvxEnabled();
+			if (avx)
+				features |= kFeature_Avx;
+
+			if (maximumLeaf >= 7)
+			{
+				cpuid(7, 0, registers);
+				const uint32_t ebx = registers[1];
+				if (avx && (ebx & (1 << 5))) features |= kFeature_Avx2;
+				if (ebx & (1 << 8)) features |= kFeature_Bmi2;
+				if (ebx & (1 << 29)) features |= kFeature_Sha;
+			}
+#endif
+			return features;
+		}
+
+	public:
+		static uint32_t GetFeatures()
+		{
+			static const uint32_t features = detect();
+			return features;
+		}
+
+		static bool HasFeature(Feature feature)
+		{
+			return (GetFeatures() & feature) != 0;
+		}
+
+		// Index of the lowest set bit, value must not be 0
+		static uint32_t CountTrailingZeros(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, value);
+			return index;
+#else
+			return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+		}
+	};
+}
+
+#endif // indigo_cpu_hpp_
@@ -10,67 +10,530 @@
 #define indigo_event_hpp_
 
 // Required libraries
+#include <atomic>
 #include <mutex>
+#include <memory>
 #include <vector>
-#include <functional>
+#include <utility>
+#include <tuple>
+#include <thread>
+#include <stdint.h>
+#include "InlineFunction.hpp"
+#include "ConcurrentQueue.hpp"
+#include "EventDispatcher.hpp"
 
 namespace indigo
 {
-	template <typename... _TArgs>
-	class Event
+	// Implemented by the subscription store of an event, so that connections
+	// can remove themselves without knowing the event argument types
+	class IEventSource
 	{
-		std::mutex mEventMutex;
-		std::vector<std::function<void(_TArgs ...)>> mCallbacks;
+	protected:
+		~IEventSource() {}
 
 	public:
-		Event() { }
-		Event(const Event &event) { }
+		virtual bool IsConnected(uint32_t index, uint32_t generation) = 0;
+		virtual bool Disconnect(uint32_t index, uint32_t generation) = 0;
+	};
 
-		template <typename _TFunction>
-		Event &Add(const _TFunction &function)
+	// Handle to a single event subscription. Copies refer to the same subscription,
+	// and a handle whose subscription or event is gone is harmless to use.
+	class EventConnection
+	{
+		std::weak_ptr<IEventSource> mSource;
+		uint32_t mIndex;
+		uint32_t mGeneration;
+
+	public:
+		EventConnection() : mIndex(0), mGeneration(0) { }
+
+		EventConnection(std::weak_ptr<IEventSource> source, uint32_t index, uint32_t generation)
+			: mSource(std::move(source)), mIndex(index), mGeneration(generation) { }
+
+		bool IsConnected() const
+		{
+			auto source = mSource.lock();
+			return source && source->IsConnected(mIndex, mGeneration);
+		}
+
+		bool Disconnect()
 		{
-			mEventMutex.lock();
-			mCallbacks.push_back(function);
-			mEventMutex.unlock();
+			auto source = mSource.lock();
+			mSource.reset();
+
+			return source && source->Disconnect(mIndex, mGeneration);
+		}
+	};
+
+	// Removes the subscription it holds when it goes out of scope
+	// Example:
+	//    ScopedEventConnection connection = response->OnFinish.Add([&](bool success) { ... });
+	class ScopedEventConnection
+	{
+		EventConnection mConnection;
+
+	public:
+		ScopedEventConnection() { }
+
+		ScopedEventConnection(EventConnection connection)
+			: mConnection(std::move(connection)) { }
+
+		ScopedEventConnection(ScopedEventConnection &&other) noexcept
+			: mConnection(other.Release()) { }
+
+		ScopedEventConnection(const ScopedEventConnection &) = delete;
+		ScopedEventConnection &operator=(const ScopedEventConnection &) = delete;
+
+		~ScopedEventConnection()
+		{
+			mConnection.Disconnect();
+		}
+
+		ScopedEventConnection &operator=(ScopedEventConnection &&other) noexcept
+		{
+			if (this != &other)
+			{
+				mConnection.Disconnect();
+				mConnection = other.Release();
+			}
 
 			return *this;
 		}
 
-		template <typename _TFunction>
-		Event &Remove(const std::function<_TFunction> &function)
+		bool IsConnected() const
+		{
+			return mConnection.IsConnected();
+		}
+
+		void Disconnect()
+		{
+			mConnection.Disconnect();
+		}
+
+		// Gives up ownership without removing the subscription
+		EventConnection Release()
 		{
-			mEventMutex.lock();
-			for (auto it = mCallbacks.begin(); it != mCallbacks.end();)
+			EventConnection connection = std::move(mConnection);
+			mConnection = EventConnection();
+			return connection;
+		}
+	};
+
+	template <typename... _TArgs>
+	class Event
+	{
+		// Callbacks are stored inline, so registering and triggering typical
+		// lambdas does not allocate
+		typedef InlineFunction<void(_TArgs ...)> Callback;
+
+		// Subscriptions live in a slot map: handles index into mSlots, which point
+		// at the densely packed callbacks in mCallbacks. Removal swaps the last
+		// callback into the hole, so both adding and removing are O(1) and a trigger
+		// walks a contiguous array. The slot generation is bumped on every removal
+		// so stale handles never match a reused slot.
+		class State : public IEventSource
+		{
+			struct Slot
 			{
-				if (it->template target<_TFunction>() == function.template target<_TFunction>())
+				uint32_t Generation;
+				uint32_t Index;
+			};
+
+			struct Entry
+			{
+				Callback Function;
+				uint32_t Slot;
+				// Written with the event locked, read by triggers without it
+				std::atomic<bool> Removed;
+
+				Entry(Callback &&function, uint32_t slot)
+					: Function(std::move(function)), Slot(slot), Removed(false) { }
+
+				Entry(Entry &&other) noexcept
+					: Function(std::move(other.Function)), Slot(other.Slot), Removed(other.Removed.load(std::memory_order_relaxed)) { }
+
+				Entry &operator=(Entry &&other) noexcept
+				{
+					Function = std::move(other.Function);
+					Slot = other.Slot;
+					Removed.store(other.Removed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					return *this;
+				}
+			};
+
+			std::mutex mMutex;
+			std::vector<Slot> mSlots;
+			std::vector<uint32_t> mFreeSlots;
+			std::vector<Entry> mCallbacks;
+			std::vector<Entry> mPending;
+			uint32_t mTriggerDepth;
+			bool mHasChanges;
+
+			// Callbacks added during a trigger are parked in mPending, since growing
+			// mCallbacks could move the callback that is currently running
+			Entry &entryAt(uint32_t position)
+			{
+				if (position < mCallbacks.size())
+					return mCallbacks[position];
+
+				return mPending[position - mCallbacks.size()];
+			}
+
+			bool isLive(uint32_t index, uint32_t generation)
+			{
+				return index < mSlots.size() && mSlots[index].Generation == generation
+					&& !entryAt(mSlots[index].Index).Removed;
+			}
+
+			void erase(uint32_t position)
+			{
+				// Move the last callback into the hole and repoint its slot, unless
+				// it was removed as well and its slot may already be reused
+				const uint32_t last = static_cast<uint32_t>(mCallbacks.size() - 1);
+				if (position != last)
+				{
+					mCallbacks[position] = std::move(mCallbacks[last]);
+					if (!mCallbacks[position].Removed)
+						mSlots[mCallbacks[position].Slot].Index = position;
+				}
+
+				mCallbacks.pop_back();
+			}
+
+			// No trigger walks mPending, so its callbacks are removed right away and
+			// churn during long or overlapping triggers does not pile up
+			void erasePending(uint32_t position)
+			{
+				const uint32_t base = static_cast<uint32_t>(mCallbacks.size());
+				const uint32_t last = static_cast<uint32_t>(mPending.size() - 1);
+				if (position - base != last)
+				{
+					mPending[position - base] = std::move(mPending[last]);
+					mSlots[mPending[position - base].Slot].Index = position;
+				}
+
+				mPending.pop_back();
+			}
+
+			void compact()
+			{
+				for (auto &entry : mPending)
+					mCallbacks.push_back(std::move(entry));
+				mPending.clear();
+
+				for (uint32_t i = 0; i < mCallbacks.size();)
+				{
+					if (mCallbacks[i].Removed)
+						erase(i);
+					else
+						i++;
+				}
+
+				mHasChanges = false;
+			}
+
+		public:
+			State() : mTriggerDepth(0), mHasChanges(false) { }
+
+			template <typename _TFunction>
+			std::pair<uint32_t, uint32_t> Add(_TFunction &&function)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+
+				uint32_t index;
+				if (!mFreeSlots.empty())
 				{
-					mCallbacks.erase(it);
-					break;
+					index = mFreeSlots.back();
+					mFreeSlots.pop_back();
 				}
-				++it;
+				else
+				{
+					index = static_cast<uint32_t>(mSlots.size());
+					mSlots.push_back({0, 0});
+				}
+
+				mSlots[index].Index = static_cast<uint32_t>(mCallbacks.size() + mPending.size());
+				if (mTriggerDepth > 0)
+				{
+					mPending.emplace_back(Callback(std::forward<_TFunction>(function)), index);
+					mHasChanges = true;
+				}
+				else
+				{
+					mCallbacks.emplace_back(Callback(std::forward<_TFunction>(function)), index);
+				}
+
+				return std::make_pair(index, mSlots[index].Generation);
+			}
+
+			bool IsConnected(uint32_t index, uint32_t generation) override
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				return isLive(index, generation);
 			}
-			mEventMutex.unlock();
 
+			bool Disconnect(uint32_t index, uint32_t generation) override
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (!isLive(index, generation))
+					return false;
+
+				const uint32_t position = mSlots[index].Index;
+				mSlots[index].Generation++;
+				mFreeSlots.push_back(index);
+
+				// A trigger is walking the array, so only mark the callback
+				// and let the trigger compact once it is done
+				if (position >= mCallbacks.size())
+				{
+					erasePending(position);
+				}
+				else if (mTriggerDepth > 0)
+				{
+					entryAt(position).Removed = true;
+					mHasChanges = true;
+				}
+				else
+				{
+					erase(position);
+				}
+
+				return true;
+			}
+
+			void Clear()
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				for (auto *entries : {&mCallbacks, &mPending})
+				{
+					for (auto &entry : *entries)
+					{
+						if (entry.Removed)
+							continue;
+
+						mSlots[entry.Slot].Generation++;
+						mFreeSlots.push_back(entry.Slot);
+						entry.Removed = true;
+					}
+				}
+
+				mPending.clear();
+				if (mTriggerDepth > 0)
+					mHasChanges = true;
+				else
+					mCallbacks.clear();
+			}
+
+			size_t GetCount()
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+
+				size_t count = 0;
+				for (auto *entries : {&mCallbacks, &mPending})
+					for (auto &entry : *entries)
+						if (!entry.Removed)
+							count++;
+
+				return count;
+			}
+
+			template <typename... _TValues>
+			void Trigger(_TValues &&... arguments)
+			{
+				// Callbacks run with the event unlocked, so they may add or remove
+				// subscriptions and trigger the event again. While a trigger runs,
+				// mCallbacks neither grows nor moves: new callbacks wait in mPending
+				// until no trigger is running, and removed ones are only marked and
+				// skipped from then on. Triggers from several threads run callbacks
+				// concurrently, and a callback removed from another thread may still
+				// be running when Disconnect returns.
+				Entry *callbacks;
+				size_t count;
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					mTriggerDepth++;
+					callbacks = mCallbacks.data();
+					count = mCallbacks.size();
+				}
+
+				for (size_t i = 0; i < count; i++)
+				{
+					if (!callbacks[i].Removed.load(std::memory_order_acquire))
+						callbacks[i].Function(arguments...);
+				}
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				mTriggerDepth--;
+				if (mTriggerDepth == 0 && mHasChanges)
+					compact();
+			}
+		};
+
+		// Triggers waiting for the dispatcher thread, when the event is asynchronous
+		class Queue : public EventDispatcher::Source
+		{
+			typedef std::tuple<typename std::decay<_TArgs>::type...> Arguments;
+
+			std::shared_ptr<State> mState;
+			EventCoalesce mCoalesce;
+			ConcurrentQueue<Arguments> mArguments;
+			std::atomic<bool> mClosed;
+
+		protected:
+			bool IsPending() override
+			{
+				return !mArguments.IsEmpty();
+			}
+
+			void Drain(size_t batchSize) override
+			{
+				Arguments arguments;
+
+				// The event is gone, drop whatever is left
+				if (mClosed.load(std::memory_order_acquire))
+				{
+					while (mArguments.TryPop(arguments)) { }
+					return;
+				}
+
+				if (mCoalesce == kEventCoalesce_Latest)
+				{
+					bool popped = false;
+					for (size_t i = 0; i < batchSize && mArguments.TryPop(arguments); i++)
+						popped = true;
+
+					if (popped)
+						invoke(arguments);
+
+					return;
+				}
+
+				for (size_t i = 0; i < batchSize && mArguments.TryPop(arguments); i++)
+					invoke(arguments);
+			}
+
+			void invoke(Arguments &arguments)
+			{
+				std::apply([this](auto &... values) { mState->Trigger(values...); }, arguments);
+			}
+
+		public:
+			Queue(std::shared_ptr<State> state, EventCoalesce coalesce, size_t capacity)
+				: mState(std::move(state)), mCoalesce(coalesce), mArguments(capacity), mClosed(false) { }
+
+			template <typename... _TValues>
+			bool Push(_TValues &&... arguments)
+			{
+				Arguments values(std::forward<_TValues>(arguments)...);
+				while (!mArguments.TryPush(std::move(values)))
+				{
+					if (mCoalesce == kEventCoalesce_Latest)
+					{
+						// Make room by dropping the oldest trigger, it would be coalesced anyway
+						Arguments dropped;
+						mArguments.TryPop(dropped);
+					}
+					else
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			void Close()
+			{
+				mClosed.store(true, std::memory_order_release);
+			}
+		};
+
+		std::shared_ptr<State> mState;
+		std::shared_ptr<Queue> mQueue;
+		EventDispatcher *mDispatcher;
+
+	public:
+		Event() : mState(std::make_shared<State>()), mDispatcher(nullptr) { }
+		Event(const Event &event) : mState(std::make_shared<State>()), mDispatcher(nullptr) { }
+
+		// Subscriptions and the dispatcher belong to the event object: copies start
+		// without any, and assigning keeps the ones this event already has
+		Event &operator=(const Event &)
+		{
 			return *this;
 		}
 
+		~Event()
+		{
+			if (mQueue)
+				mQueue->Close();
+		}
+
+		// Makes triggers asynchronous: arguments are copied into a lock-free queue of
+		// the given capacity and the callbacks run later on the dispatcher's thread.
+		// Passing nullptr makes the event synchronous again. Call this before the
+		// event is triggered, it is not safe to change while other threads trigger it.
+		void SetDispatcher(EventDispatcher *dispatcher, EventCoalesce coalesce = kEventCoalesce_None, size_t capacity = 1024)
+		{
+			if (mQueue)
+				mQueue->Close();
+
+			mDispatcher = dispatcher;
+			if (dispatcher != nullptr)
+				mQueue = std::make_shared<Queue>(mState, coalesce, capacity);
+			else
+				mQueue.reset();
+		}
+
+		// Subscribes a callback. The returned handle can be ignored, kept to remove
+		// the callback later, or wrapped in a ScopedEventConnection.
+		template <typename _TFunction>
+		EventConnection Add(_TFunction &&function)
+		{
+			const auto slot = mState->Add(std::forward<_TFunction>(function));
+			return EventConnection(std::weak_ptr<IEventSource>(mState), slot.first, slot.second);
+		}
+
+		bool Remove(EventConnection &connection)
+		{
+			return connection.Disconnect();
+		}
+
 		void Clear()
 		{
-			mEventMutex.lock();
-			mCallbacks.clear();
-			mEventMutex.unlock();
+			mState->Clear();
+		}
+
+		// Number of live subscriptions
+		size_t GetCount() const
+		{
+			return mState->GetCount();
 		}
 
+		// Callbacks are called in no particular order
 		void Trigger(_TArgs ... arguments)
 		{
-			std::vector<std::function<void(_TArgs ...)>> callbacks(mCallbacks.size());
+			if (!mQueue)
+			{
+				mState->Trigger(arguments...);
+				return;
+			}
 
-			mEventMutex.lock();
-			std::copy(mCallbacks.begin(), mCallbacks.end(), callbacks.begin());
-			mEventMutex.unlock();
+			// While the queue is full, wait for the dispatcher to catch up, unless this
+			// is the dispatcher itself, which has to deliver the trigger right away
+			while (!mQueue->Push(arguments...))
+			{
+				if (mDispatcher->IsDispatcherThread())
+				{
+					mState->Trigger(arguments...);
+					return;
+				}
+
+				mDispatcher->Schedule(mQueue);
+				std::this_thread::yield();
+			}
 
-			for (auto iterator = callbacks.begin(); iterator != callbacks.end(); ++iterator)
-				(*iterator)(arguments...);
+			mDispatcher->Schedule(mQueue);
 		}
 
 		void operator()(_TArgs ... arguments)
@@ -0,0 +1,202 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_event_dispatcher_hpp_
+#define indigo_event_dispatcher_hpp_
+
+// Required libraries
+#include "ManualReset.hpp"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstddef>
+
+namespace indigo
+{
+	// How an asynchronous event treats triggers that are still queued
+	enum EventCoalesce
+	{
+		// Every trigger is delivered, in order
+		kEventCoalesce_None,
+		// Only the most recent queued trigger is delivered, e.g. for progress updates
+		kEventCoalesce_Latest
+	};
+
+	// Runs the callbacks of asynchronous events on its own thread. Triggering an event
+	// only queues its arguments; the dispatcher drains each event's queue in batches.
+	// The dispatcher must outlive the events that use it.
+	// Example:
+	//    EventDispatcher dispatcher;
+	//    response->OnProgressChanged.SetDispatcher(&dispatcher, kEventCoalesce_Latest);
+	class EventDispatcher
+	{
+		struct Node
+		{
+			std::atomic<Node *> Next;
+
+			Node() : Next(nullptr) { }
+		};
+
+	public:
+		// A queue of pending triggers, implemented by Event
+		class Source : Node
+		{
+			friend class EventDispatcher;
+
+			std::atomic<bool> mScheduled;
+			std::shared_ptr<Source> mKeepAlive;
+
+		protected:
+			Source() : mScheduled(false) { }
+
+			virtual bool IsPending() = 0;
+			virtual void Drain(size_t batchSize) = 0;
+
+		public:
+			virtual ~Source() { }
+		};
+
+	private:
+		// Intrusive multi-producer single-consumer list of scheduled sources,
+		// so scheduling never allocates or locks
+		std::atomic<Node *> mHead;
+		Node *mTail;
+		Node mStub;
+
+		size_t mBatchSize;
+		std::atomic<bool> mStopping;
+		ManualReset mSignal;
+		std::thread mThread;
+
+		void push(Node *node)
+		{
+			node->Next.store(nullptr, std::memory_order_relaxed);
+			Node *previous = mHead.exchange(node, std::memory_order_acq_rel);
+			previous->Next.store(node, std::memory_order_release);
+		}
+
+		Node *pop()
+		{
+			Node *tail = mTail;
+			Node *next = tail->Next.load(std::memory_order_acquire);
+			if (tail == &mStub)
+			{
+				if (next == nullptr)
+					return nullptr;
+
+				mTail = next;
+				tail = next;
+				next = next->Next.load(std::memory_order_acquire);
+			}
+
+			if (next != nullptr)
+			{
+				mTail = next;
+				return tail;
+			}
+
+			// A producer is halfway through a push, it signals once it is done
+			if (tail != mHead.load(std::memory_order_acquire))
+				return nullptr;
+
+			push(&mStub);
+
+			next = tail->Next.load(std::memory_order_acquire);
+			if (next != nullptr)
+			{
+				mTail = next;
+				return tail;
+			}
+
+			return nullptr;
+		}
+
+		void dispatch(Source *source)
+		{
+			std::shared_ptr<Source> keepAlive = std::move(source->mKeepAlive);
+			source->Drain(mBatchSize);
+
+			// Anything queued after the drain, or beyond the batch, goes to the back
+			// of the line so a busy event cannot starve the others
+			source->mScheduled.store(false, std::memory_order_seq_cst);
+			if (source->IsPending())
+				Schedule(keepAlive);
+		}
+
+		void run()
+		{
+			for (;;)
+			{
+				Node *node = pop();
+				if (node == nullptr)
+				{
+					// The list is only empty once the tail caught up with the head;
+					// otherwise a producer has swapped the head but not linked its
+					// node yet, and stopping now would drop that trigger
+					if (mStopping.load())
+					{
+						if (mHead.load(std::memory_order_acquire) == mTail)
+							break;
+
+						std::this_thread::yield();
+						continue;
+					}
+
+					mSignal.Reset();
+					node = pop();
+					if (node == nullptr)
+					{
+						if (!mStopping.load())
+							mSignal.Wait();
+
+						continue;
+					}
+				}
+
+				dispatch(static_cast<Source *>(node));
+			}
+		}
+
+	public:
+		explicit EventDispatcher(size_t batchSize = 64)
+			: mHead(&mStub), mTail(&mStub), mBatchSize(batchSize), mStopping(false)
+		{
+			mThread = std::thread(&EventDispatcher::run, this);
+		}
+
+		EventDispatcher(const EventDispatcher &) = delete;
+		EventDispatcher &operator=(const EventDispatcher &) = delete;
+
+		// Delivers everything that is still queued before returning
+		~EventDispatcher()
+		{
+			mStopping.store(true);
+			mSignal.Set();
+			mThread.join();
+		}
+
+		template <typename _TSource>
+		void Schedule(const std::shared_ptr<_TSource> &source)
+		{
+			// Already waiting to be drained
+			if (source->mScheduled.exchange(true, std::memory_order_seq_cst))
+				return;
+
+			source->mKeepAlive = source;
+			push(source.get());
+			mSignal.Set();
+		}
+
+		bool IsDispatcherThread() const
+		{
+			return std::this_thread::get_id() == mThread.get_id();
+		}
+	};
+}
+
+#endif // indigo_event_dispatcher_hpp_
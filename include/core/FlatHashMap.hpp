@@ -0,0 +1,158 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_flat_hash_map_hpp_
+#define indigo_flat_hash_map_hpp_
+
+// Required libraries
+#include "FlatHashTable.hpp"
+#include <initializer_list>
+#include <tuple>
+
+namespace indigo
+{
+	template <typename _TKey, typename _TValue>
+	struct FlatHashMapPolicy
+	{
+		typedef _TKey Key;
+		typedef std::pair<const _TKey, _TValue> Slot;
+		static constexpr bool kMutable = true;
+
+		static const _TKey &GetKey(const Slot &slot)
+		{
+			return slot.first;
+		}
+
+		// The old slot is destroyed right after, so nothing sees its moved-from key
+		static void Relocate(Slot *to, Slot *from)
+		{
+			new (to) Slot(std::move(const_cast<_TKey &>(from->first)), std::move(from->second));
+			from->~Slot();
+		}
+	};
+
+	// Hash map that keeps its elements in one flat array instead of a node each,
+	// so a lookup is a hash, a 16-byte compare and usually a single key compare.
+	// It has the std::unordered_map interface, except that inserting or erasing
+	// moves elements and invalidates all iterators and references. String keys can
+	// be looked up with a std::string_view or a literal without building a string.
+	// Example:
+	//    FlatHashMap<std::string, int> scores = { { "alice", 3 } };
+	//    scores["bob"] += 2;
+	//    auto it = scores.find(std::string_view("alice"));
+	//    if (it != scores.end())
+	//        ...
+	template <typename _TKey, typename _TValue, typename _THasher = FlatHash<_TKey>, typename _TEqual = std::equal_to<>>
+	class FlatHashMap : public FlatHashTable<FlatHashMapPolicy<_TKey, _TValue>, _THasher, _TEqual>
+	{
+		typedef FlatHashTable<FlatHashMapPolicy<_TKey, _TValue>, _THasher, _TEqual> Table;
+
+		template <typename _TLookup, typename... _TArgs>
+		std::pair<typename Table::iterator, bool> tryEmplace(_TLookup &&key, _TArgs &&... arguments)
+		{
+			size_t hash;
+			const auto found = this->findOrPrepare(key, hash);
+			if (!found.second)
+			{
+				new (this->getSlot(found.first)) typename Table::value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<_TLookup>(key)),
+				                                                            std::forward_as_tuple(std::forward<_TArgs>(arguments)...));
+				this->commitInsert(found.first, hash);
+			}
+
+			return { this->iteratorAt(found.first), !found.second };
+		}
+
+	public:
+		typedef _TValue mapped_type;
+
+		FlatHashMap() = default;
+
+		explicit FlatHashMap(size_t capacity, const _THasher &hasher = _THasher(), const _TEqual &equal = _TEqual())
+			: Table(capacity, hasher, equal) { }
+
+		FlatHashMap(std::initializer_list<typename Table::value_type> values)
+		{
+			this->reserve(values.size());
+			for (const auto &value : values)
+				insert(value);
+		}
+
+		template <typename _TIterator>
+		FlatHashMap(_TIterator first, _TIterator last)
+		{
+			for (; first != last; ++first)
+				insert(*first);
+		}
+
+		// Does nothing if the key is already there, like std::unordered_map
+		template <typename... _TArgs>
+		std::pair<typename Table::iterator, bool> try_emplace(const _TKey &key, _TArgs &&... arguments)
+		{
+			return tryEmplace(key, std::forward<_TArgs>(arguments)...);
+		}
+
+		template <typename... _TArgs>
+		std::pair<typename Table::iterator, bool> try_emplace(_TKey &&key, _TArgs &&... arguments)
+		{
+			return tryEmplace(std::move(key), std::forward<_TArgs>(arguments)...);
+		}
+
+		// The key is only converted to _TKey when it has to be inserted
+		template <typename _TLookup, typename... _TArgs, typename = typename Table::template enable_lookup_t<_TLookup>>
+		std::pair<typename Table::iterator, bool> try_emplace(_TLookup &&key, _TArgs &&... arguments)
+		{
+			return tryEmplace(std::forward<_TLookup>(key), std::forward<_TArgs>(arguments)...);
+		}
+
+		template <typename _TLookup, typename _TInput>
+		std::pair<typename Table::iterator, bool> emplace(_TLookup &&key, _TInput &&value)
+		{
+			return try_emplace(std::forward<_TLookup>(key), std::forward<_TInput>(value));
+		}
+
+		template <typename _TFirst, typename _TSecond>
+		std::pair<typename Table::iterator, bool> insert(const std::pair<_TFirst, _TSecond> &value)
+		{
+			return try_emplace(value.first, value.second);
+		}
+
+		template <typename _TFirst, typename _TSecond>
+		std::pair<typename Table::iterator, bool> insert(std::pair<_TFirst, _TSecond> &&value)
+		{
+			return try_emplace(std::forward<_TFirst>(value.first), std::forward<_TSecond>(value.second));
+		}
+
+		template <typename _TLookup, typename _TInput>
+		std::pair<typename Table::iterator, bool> insert_or_assign(_TLookup &&key, _TInput &&value)
+		{
+			auto result = try_emplace(std::forward<_TLookup>(key), std::forward<_TInput>(value));
+			if (!result.second)
+				result.first->second = std::forward<_TInput>(value);
+
+			return result;
+		}
+
+		_TValue &operator[](const _TKey &key)
+		{
+			return try_emplace(key).first->second;
+		}
+
+		_TValue &operator[](_TKey &&key)
+		{
+			return try_emplace(std::move(key)).first->second;
+		}
+
+		template <typename _TLookup, typename = typename Table::template enable_lookup_t<_TLookup>>
+		_TValue &operator[](_TLookup &&key)
+		{
+			return try_emplace(std::forward<_TLookup>(key)).first->second;
+		}
+	};
+}
+
+#endif // indigo_flat_hash_map_hpp_
@@ -0,0 +1,108 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_flat_hash_set_hpp_
+#define indigo_flat_hash_set_hpp_
+
+// Required libraries
+#include "FlatHashTable.hpp"
+#include <initializer_list>
+
+namespace indigo
+{
+	template <typename _TKey>
+	struct FlatHashSetPolicy
+	{
+		typedef _TKey Key;
+		typedef _TKey Slot;
+		static constexpr bool kMutable = false;
+
+		static const _TKey &GetKey(const Slot &slot)
+		{
+			return slot;
+		}
+
+		static void Relocate(Slot *to, Slot *from)
+		{
+			new (to) Slot(std::move(*from));
+			from->~Slot();
+		}
+	};
+
+	// Hash set counterpart of FlatHashMap, with the same layout and the same
+	// rules: elements move on insert and erase, and string sets can be searched
+	// with a std::string_view.
+	// Example:
+	//    FlatHashSet<std::string> seen;
+	//    if (!seen.insert(name).second)
+	//        ...
+	template <typename _TKey, typename _THasher = FlatHash<_TKey>, typename _TEqual = std::equal_to<>>
+	class FlatHashSet : public FlatHashTable<FlatHashSetPolicy<_TKey>, _THasher, _TEqual>
+	{
+		typedef FlatHashTable<FlatHashSetPolicy<_TKey>, _THasher, _TEqual> Table;
+
+		template <typename _TInput>
+		std::pair<typename Table::iterator, bool> insertKey(_TInput &&key)
+		{
+			size_t hash;
+			const auto found = this->findOrPrepare(key, hash);
+			if (!found.second)
+			{
+				new (this->getSlot(found.first)) _TKey(std::forward<_TInput>(key));
+				this->commitInsert(found.first, hash);
+			}
+
+			return { this->iteratorAt(found.first), !found.second };
+		}
+
+	public:
+		FlatHashSet() = default;
+
+		explicit FlatHashSet(size_t capacity, const _THasher &hasher = _THasher(), const _TEqual &equal = _TEqual())
+			: Table(capacity, hasher, equal) { }
+
+		FlatHashSet(std::initializer_list<_TKey> keys)
+		{
+			this->reserve(keys.size());
+			for (const auto &key : keys)
+				insert(key);
+		}
+
+		template <typename _TIterator>
+		FlatHashSet(_TIterator first, _TIterator last)
+		{
+			for (; first != last; ++first)
+				insert(*first);
+		}
+
+		std::pair<typename Table::iterator, bool> insert(const _TKey &key)
+		{
+			return insertKey(key);
+		}
+
+		std::pair<typename Table::iterator, bool> insert(_TKey &&key)
+		{
+			return insertKey(std::move(key));
+		}
+
+		// The key is only converted to _TKey when it has to be inserted
+		template <typename _TLookup, typename = typename Table::template enable_lookup_t<_TLookup>>
+		std::pair<typename Table::iterator, bool> insert(_TLookup &&key)
+		{
+			return insertKey(std::forward<_TLookup>(key));
+		}
+
+		template <typename _TInput>
+		std::pair<typename Table::iterator, bool> emplace(_TInput &&key)
+		{
+			return insert(std::forward<_TInput>(key));
+		}
+	};
+}
+
+#endif // indigo_flat_hash_set_hpp_
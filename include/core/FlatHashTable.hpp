@@ -0,0 +1,678 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_flat_hash_table_hpp_
+#define indigo_flat_hash_table_hpp_
+
+// Required libraries
+#include "../utility/XXHash.hpp"
+#include "Cpu.hpp"
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Default hasher for the flat hash containers. The tables take their bucket
+	// from the high bits and a tag from the low seven, so every bit has to depend
+	// on the whole key; std::hash of an integer is the integer itself, which is
+	// why its result is mixed. Strings go through XXH3 and can be looked up with
+	// anything that converts to std::string_view.
+	template <typename _TKey>
+	struct FlatHash
+	{
+		static size_t Mix(uint64_t value)
+		{
+			value ^= value >> 32;
+			value *= 0x9E3779B97F4A7C15;
+			value ^= value >> 29;
+			return static_cast<size_t>(value);
+		}
+
+		size_t operator()(const _TKey &key) const
+		{
+			return Mix(static_cast<uint64_t>(std::hash<_TKey>()(key)));
+		}
+	};
+
+	template <>
+	struct FlatHash<std::string_view>
+	{
+		typedef void is_transparent;
+
+		size_t operator()(std::string_view key) const
+		{
+			return static_cast<size_t>(XXHash::XXH3_64(key.data(), key.size()));
+		}
+	};
+
+	template <>
+	struct FlatHash<std::string> : FlatHash<std::string_view> { };
+
+	// Open-addressing table behind FlatHashMap and FlatHashSet, after Google's
+	// SwissTable. Slots sit in one array and a control byte per slot says whether
+	// it is empty, deleted or full; a full slot's byte holds seven bits of its
+	// hash. Lookups compare 16 control bytes at once, so they only touch a slot
+	// whose tag matches, and stop at the first group with an empty slot.
+	// The policy gives the slot type, how to get its key and how to move it.
+	template <typename _TPolicy, typename _THasher, typename _TEqual>
+	class FlatHashTable
+	{
+	public:
+		typedef typename _TPolicy::Key key_type;
+		typedef typename _TPolicy::Slot value_type;
+		typedef size_t size_type;
+		typedef _THasher hasher;
+		typedef _TEqual key_equal;
+
+	private:
+		static constexpr size_t kGroupSize = 16;
+		static constexpr uint8_t kEmpty = 0x80;
+		static constexpr uint8_t kDeleted = 0xFE;
+		static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+		// Bit masks over the 16 control bytes of a group
+		class Group
+		{
+#if defined(INDIGO_SSE2)
+			__m128i mControl;
+
+		public:
+			explicit Group(const uint8_t *control)
+				: mControl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(control))) { }
+
+			uint32_t Match(uint8_t tag) const
+			{
+				return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(mControl, _mm_set1_epi8(static_cast<char>(tag)))));
+			}
+
+			uint32_t MatchEmpty() const
+			{
+				return Match(kEmpty);
+			}
+
+			// Full slots have the top bit clear
+			uint32_t MatchEmptyOrDeleted() const
+			{
+				return static_cast<uint32_t>(_mm_movemask_epi8(mControl));
+			}
+#else
+			const uint8_t *mControl;
+
+		public:
+			explicit Group(const uint8_t *control) : mControl(control) { }
+
+			uint32_t Match(uint8_t tag) const
+			{
+				uint32_t mask = 0;
+				for (size_t i = 0; i < kGroupSize; i++)
+					mask |= static_cast<uint32_t>(mControl[i] == tag) << i;
+
+				return mask;
+			}
+
+			uint32_t MatchEmpty() const
+			{
+				return Match(kEmpty);
+			}
+
+			uint32_t MatchEmptyOrDeleted() const
+			{
+				uint32_t mask = 0;
+				for (size_t i = 0; i < kGroupSize; i++)
+					mask |= static_cast<uint32_t>(mControl[i] >> 7) << i;
+
+				return mask;
+			}
+#endif
+		};
+
+		template <bool _Const>
+		class Iterator
+		{
+			friend class FlatHashTable;
+
+			const uint8_t *mControl;
+			const uint8_t *mEnd;
+			typename FlatHashTable::value_type *mSlot;
+
+			Iterator(const uint8_t *control, const uint8_t *end, typename FlatHashTable::value_type *slot)
+				: mControl(control), mEnd(end), mSlot(slot) { }
+
+			void skipFree()
+			{
+				while (mControl != mEnd && (*mControl & 0x80) != 0)
+				{
+					mControl++;
+					mSlot++;
+				}
+			}
+
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef typename FlatHashTable::value_type value_type;
+			typedef ptrdiff_t difference_type;
+			typedef std::conditional_t<_Const, const value_type *, value_type *> pointer;
+			typedef std::conditional_t<_Const, const value_type &, value_type &> reference;
+
+			Iterator() : mControl(nullptr), mEnd(nullptr), mSlot(nullptr) { }
+
+			// Anything mutable converts to const
+			template <bool _OtherConst, typename = std::enable_if_t<_Const && !_OtherConst>>
+			Iterator(const Iterator<_OtherConst> &other)
+				: mControl(other.mControl), mEnd(other.mEnd), mSlot(other.mSlot) { }
+
+			reference operator*() const
+			{
+				return *mSlot;
+			}
+
+			pointer operator->() const
+			{
+				return mSlot;
+			}
+
+			Iterator &operator++()
+			{
+				mControl++;
+				mSlot++;
+				skipFree();
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				Iterator result = *this;
+				++*this;
+				return result;
+			}
+
+			bool operator==(const Iterator &other) const
+			{
+				return mSlot == other.mSlot;
+			}
+
+			bool operator!=(const Iterator &other) const
+			{
+				return mSlot != other.mSlot;
+			}
+
+			template <bool>
+			friend class Iterator;
+		};
+
+		// Heterogeneous lookup is only allowed when the hasher declares it
+		template <typename _THash, typename = void>
+		struct isTransparent : std::false_type { };
+
+		template <typename _THash>
+		struct isTransparent<_THash, std::void_t<typename _THash::is_transparent>> : std::true_type { };
+
+	public:
+		typedef Iterator<!_TPolicy::kMutable> iterator;
+		typedef Iterator<true> const_iterator;
+
+	protected:
+		// Lookups by anything but the key type itself, iterators excluded
+		template <typename _TLookup>
+		using enable_lookup_t = std::enable_if_t<isTransparent<_THasher>::value && !std::is_same<std::decay_t<_TLookup>, key_type>::value
+		                                         && !std::is_convertible<_TLookup, const_iterator>::value>;
+
+	private:
+		uint8_t *mControl;
+		value_type *mSlots;
+		size_t mCapacity;
+		size_t mSize;
+		size_t mGrowthLeft;
+		_THasher mHasher;
+		_TEqual mEqual;
+
+		static uint8_t getTag(size_t hash)
+		{
+			return static_cast<uint8_t>(hash & 0x7F);
+		}
+
+		// Tables are kept at most 7/8 full, so a probe always finds an empty slot
+		static size_t getMaxLoad(size_t capacity)
+		{
+			return capacity - capacity / 8;
+		}
+
+		iterator makeIterator(size_t index) const
+		{
+			return iterator(mControl + index, mControl + mCapacity, mSlots + index);
+		}
+
+		// Groups are visited 0, 1, 3, 6, ... apart, which reaches every one of a
+		// power of two number of groups
+		template <typename _TLookup>
+		size_t findIndex(const _TLookup &key, size_t hash) const
+		{
+			if (mCapacity == 0)
+				return kNotFound;
+
+			const size_t mask = mCapacity / kGroupSize - 1;
+			const uint8_t tag = getTag(hash);
+			size_t group = (hash >> 7) & mask;
+			for (size_t step = 1;; step++)
+			{
+				const Group control(mControl + group * kGroupSize);
+				for (uint32_t match = control.Match(tag); match != 0; match &= match - 1)
+				{
+					const size_t index = group * kGroupSize + Cpu::CountTrailingZeros(match);
+					if (mEqual(_TPolicy::GetKey(mSlots[index]), key))
+						return index;
+				}
+
+				if (control.MatchEmpty() != 0)
+					return kNotFound;
+
+				group = (group + step) & mask;
+			}
+		}
+
+		// Mutable, so the public find can hand out either kind of iterator
+		template <typename _TLookup>
+		iterator findIterator(const _TLookup &key) const
+		{
+			const size_t index = findIndex(key, mHasher(key));
+			return makeIterator(index == kNotFound ? mCapacity : index);
+		}
+
+		template <typename _TLookup>
+		size_t eraseKey(const _TLookup &key)
+		{
+			const size_t index = findIndex(key, mHasher(key));
+			if (index == kNotFound)
+				return 0;
+
+			eraseIndex(index);
+			return 1;
+		}
+
+		size_t findFreeIndex(size_t hash) const
+		{
+			const size_t mask = mCapacity / kGroupSize - 1;
+			size_t group = (hash >> 7) & mask;
+			for (size_t step = 1;; step++)
+			{
+				const uint32_t free = Group(mControl + group * kGroupSize).MatchEmptyOrDeleted();
+				if (free != 0)
+					return group * kGroupSize + Cpu::CountTrailingZeros(free);
+
+				group = (group + step) & mask;
+			}
+		}
+
+		void allocate(size_t capacity)
+		{
+			mControl = new uint8_t[capacity];
+			try
+			{
+				mSlots = std::allocator<value_type>().allocate(capacity);
+			}
+			catch (...)
+			{
+				delete[] mControl;
+				throw;
+			}
+
+			memset(mControl, kEmpty, capacity);
+			mCapacity = capacity;
+			mGrowthLeft = getMaxLoad(capacity);
+		}
+
+		void destroyAll()
+		{
+			if (!std::is_trivially_destructible<value_type>::value)
+				for (size_t i = 0; i < mCapacity; i++)
+					if ((mControl[i] & 0x80) == 0)
+						mSlots[i].~value_type();
+		}
+
+		void release()
+		{
+			if (mCapacity == 0)
+				return;
+
+			destroyAll();
+			std::allocator<value_type>().deallocate(mSlots, mCapacity);
+			delete[] mControl;
+			mControl = nullptr;
+			mSlots = nullptr;
+			mCapacity = 0;
+			mSize = 0;
+			mGrowthLeft = 0;
+		}
+
+		// Moves every element into a new table, which also drops the tombstones
+		void rehash(size_t capacity)
+		{
+			uint8_t *const oldControl = mControl;
+			value_type *const oldSlots = mSlots;
+			const size_t oldCapacity = mCapacity;
+			allocate(capacity);
+
+			for (size_t i = 0; i < oldCapacity; i++)
+			{
+				if ((oldControl[i] & 0x80) != 0)
+					continue;
+
+				const size_t hash = mHasher(_TPolicy::GetKey(oldSlots[i]));
+				const size_t index = findFreeIndex(hash);
+				_TPolicy::Relocate(mSlots + index, oldSlots + i);
+				mControl[index] = getTag(hash);
+			}
+
+			mGrowthLeft -= mSize;
+			if (oldCapacity > 0)
+			{
+				std::allocator<value_type>().deallocate(oldSlots, oldCapacity);
+				delete[] oldControl;
+			}
+		}
+
+		static size_t getCapacityFor(size_t size)
+		{
+			size_t capacity = kGroupSize;
+			while (getMaxLoad(capacity) < size)
+				capacity *= 2;
+
+			return capacity;
+		}
+
+	protected:
+		// Returns the element's index and true, or where it should go and false.
+		// Nothing changes until commitInsert, so a throwing constructor leaves the
+		// table as it was.
+		template <typename _TLookup>
+		std::pair<size_t, bool> findOrPrepare(const _TLookup &key, size_t &hash)
+		{
+			hash = mHasher(key);
+			const size_t index = findIndex(key, hash);
+			if (index != kNotFound)
+				return { index, true };
+
+			if (mCapacity == 0)
+				rehash(kGroupSize);
+
+			size_t free = findFreeIndex(hash);
+			if (mGrowthLeft == 0 && mControl[free] != kDeleted)
+			{
+				// Mostly tombstones: clean up in place instead of growing
+				rehash(mSize < getMaxLoad(mCapacity) / 2 ? mCapacity : mCapacity * 2);
+				free = findFreeIndex(hash);
+			}
+
+			return { free, false };
+		}
+
+		void commitInsert(size_t index, size_t hash)
+		{
+			if (mControl[index] == kEmpty)
+				mGrowthLeft--;
+
+			mControl[index] = getTag(hash);
+			mSize++;
+		}
+
+		value_type *getSlot(size_t index) const
+		{
+			return mSlots + index;
+		}
+
+		iterator iteratorAt(size_t index) const
+		{
+			return makeIterator(index);
+		}
+
+		void eraseIndex(size_t index)
+		{
+			mSlots[index].~value_type();
+			mSize--;
+
+			// A group that still has an empty slot never made a probe move on, so
+			// the slot can be empty again instead of a tombstone
+			const size_t group = index / kGroupSize * kGroupSize;
+			if (Group(mControl + group).MatchEmpty() != 0)
+			{
+				mControl[index] = kEmpty;
+				mGrowthLeft++;
+			}
+			else
+			{
+				mControl[index] = kDeleted;
+			}
+		}
+
+	public:
+		FlatHashTable()
+			: mControl(nullptr), mSlots(nullptr), mCapacity(0), mSize(0), mGrowthLeft(0) { }
+
+		explicit FlatHashTable(size_t capacity, const _THasher &hasher = _THasher(), const _TEqual &equal = _TEqual())
+			: mControl(nullptr), mSlots(nullptr), mCapacity(0), mSize(0), mGrowthLeft(0), mHasher(hasher), mEqual(equal)
+		{
+			reserve(capacity);
+		}
+
+		FlatHashTable(const FlatHashTable &other)
+			: mControl(nullptr), mSlots(nullptr), mCapacity(0), mSize(0), mGrowthLeft(0), mHasher(other.mHasher), mEqual(other.mEqual)
+		{
+			reserve(other.mSize);
+			for (const value_type &value : other)
+			{
+				size_t hash;
+				const size_t index = findOrPrepare(_TPolicy::GetKey(value), hash).first;
+				new (mSlots + index) value_type(value);
+				commitInsert(index, hash);
+			}
+		}
+
+		FlatHashTable(FlatHashTable &&other) noexcept
+			: mControl(other.mControl), mSlots(other.mSlots), mCapacity(other.mCapacity), mSize(other.mSize), mGrowthLeft(other.mGrowthLeft),
+			  mHasher(std::move(other.mHasher)), mEqual(std::move(other.mEqual))
+		{
+			other.mControl = nullptr;
+			other.mSlots = nullptr;
+			other.mCapacity = 0;
+			other.mSize = 0;
+			other.mGrowthLeft = 0;
+		}
+
+		FlatHashTable &operator=(const FlatHashTable &other)
+		{
+			if (this != &other)
+			{
+				FlatHashTable copy(other);
+				swap(copy);
+			}
+
+			return *this;
+		}
+
+		FlatHashTable &operator=(FlatHashTable &&other) noexcept
+		{
+			if (this != &other)
+			{
+				release();
+				swap(other);
+			}
+
+			return *this;
+		}
+
+		~FlatHashTable()
+		{
+			release();
+		}
+
+		void swap(FlatHashTable &other) noexcept
+		{
+			std::swap(mControl, other.mControl);
+			std::swap(mSlots, other.mSlots);
+			std::swap(mCapacity, other.mCapacity);
+			std::swap(mSize, other.mSize);
+			std::swap(mGrowthLeft, other.mGrowthLeft);
+			std::swap(mHasher, other.mHasher);
+			std::swap(mEqual, other.mEqual);
+		}
+
+		iterator begin()
+		{
+			iterator it = makeIterator(0);
+			it.skipFree();
+			return it;
+		}
+
+		const_iterator begin() const
+		{
+			iterator it = makeIterator(0);
+			it.skipFree();
+			return it;
+		}
+
+		iterator end()
+		{
+			return makeIterator(mCapacity);
+		}
+
+		const_iterator end() const
+		{
+			return makeIterator(mCapacity);
+		}
+
+		const_iterator cbegin() const
+		{
+			return begin();
+		}
+
+		const_iterator cend() const
+		{
+			return end();
+		}
+
+		bool empty() const
+		{
+			return mSize == 0;
+		}
+
+		size_t size() const
+		{
+			return mSize;
+		}
+
+		size_t capacity() const
+		{
+			return mCapacity;
+		}
+
+		// Keeps the memory
+		void clear()
+		{
+			destroyAll();
+			if (mCapacity > 0)
+				memset(mControl, kEmpty, mCapacity);
+
+			mSize = 0;
+			mGrowthLeft = getMaxLoad(mCapacity);
+		}
+
+		// Makes room for size elements without any further rehash
+		void reserve(size_t size)
+		{
+			const size_t capacity = getCapacityFor(size);
+			if (capacity > mCapacity)
+				rehash(capacity);
+		}
+
+		iterator find(const key_type &key)
+		{
+			return findIterator(key);
+		}
+
+		const_iterator find(const key_type &key) const
+		{
+			return findIterator(key);
+		}
+
+		template <typename _TLookup, typename = enable_lookup_t<_TLookup>>
+		iterator find(const _TLookup &key)
+		{
+			return findIterator(key);
+		}
+
+		template <typename _TLookup, typename = enable_lookup_t<_TLookup>>
+		const_iterator find(const _TLookup &key) const
+		{
+			return findIterator(key);
+		}
+
+		bool contains(const key_type &key) const
+		{
+			return findIndex(key, mHasher(key)) != kNotFound;
+		}
+
+		template <typename _TLookup, typename = enable_lookup_t<_TLookup>>
+		bool contains(const _TLookup &key) const
+		{
+			return findIndex(key, mHasher(key)) != kNotFound;
+		}
+
+		size_t count(const key_type &key) const
+		{
+			return contains(key) ? 1 : 0;
+		}
+
+		template <typename _TLookup, typename = enable_lookup_t<_TLookup>>
+		size_t count(const _TLookup &key) const
+		{
+			return contains(key) ? 1 : 0;
+		}
+
+		// Returns the iterator following the erased element
+		iterator erase(const_iterator position)
+		{
+			const size_t index = static_cast<size_t>(position.mSlot - mSlots);
+			eraseIndex(index);
+			iterator next = makeIterator(index);
+			next.skipFree();
+			return next;
+		}
+
+		size_t erase(const key_type &key)
+		{
+			return eraseKey(key);
+		}
+
+		template <typename _TLookup, typename = enable_lookup_t<_TLookup>>
+		size_t erase(const _TLookup &key)
+		{
+			return eraseKey(key);
+		}
+
+		hasher hash_function() const
+		{
+			return mHasher;
+		}
+
+		key_equal key_eq() const
+		{
+			return mEqual;
+		}
+	};
+}
+
+#endif // indigo_flat_hash_table_hpp_
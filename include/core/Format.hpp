@@ -0,0 +1,554 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_format_hpp_
+#define indigo_format_hpp_
+
+// Required libraries
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+// Format strings are checked while compiling when the compiler supports consteval,
+// and parsed once per call otherwise
+#if defined(__cpp_consteval)
+#define INDIGO_CONSTEVAL consteval
+#else
+#define INDIGO_CONSTEVAL constexpr
+#endif
+
+namespace indigo
+{
+	// One printf style conversion, e.g. "%-8.3f"
+	struct FormatSpec
+	{
+		// Range of the conversion in the format string
+		size_t Begin = 0;
+		size_t End = 0;
+
+		bool LeftAlign = false;
+		bool ZeroPad = false;
+		bool Plus = false;
+		bool Space = false;
+		bool Alternate = false;
+		int Width = 0;
+		// -1 when not given
+		int Precision = -1;
+		char Conversion = 0;
+	};
+
+	// A type-erased argument, so the formatting code is shared between all calls
+	class FormatArgument
+	{
+	public:
+		enum Type
+		{
+			kType_None,
+			kType_Bool,
+			kType_Char,
+			kType_Signed,
+			kType_Unsigned,
+			kType_Float,
+			kType_String,
+			kType_Pointer
+		};
+
+		template <typename _TValue>
+		static constexpr Type GetType()
+		{
+			using Value = std::decay_t<_TValue>;
+			if constexpr (std::is_same_v<Value, bool>)
+				return kType_Bool;
+			else if constexpr (std::is_same_v<Value, char>)
+				return kType_Char;
+			else if constexpr (std::is_enum_v<Value>)
+				return GetType<std::underlying_type_t<Value>>();
+			else if constexpr (std::is_integral_v<Value>)
+				return std::is_signed_v<Value> ? kType_Signed : kType_Unsigned;
+			else if constexpr (std::is_floating_point_v<Value>)
+				return kType_Float;
+			else if constexpr (std::is_same_v<Value, const char *> || std::is_same_v<Value, char *> ||
+				std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+				return kType_String;
+			else if constexpr (std::is_pointer_v<Value> || std::is_null_pointer_v<Value>)
+				return kType_Pointer;
+			else
+				return kType_None;
+		}
+
+		// Whether a conversion character accepts an argument of the given type
+		static constexpr bool IsCompatible(char conversion, Type type)
+		{
+			switch (conversion)
+			{
+			case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+				return type == kType_Bool || type == kType_Char || type == kType_Signed || type == kType_Unsigned;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+				return type == kType_Float || type == kType_Signed || type == kType_Unsigned;
+			case 'p':
+				return type == kType_Pointer;
+			case 's':
+				return type != kType_None;
+			default:
+				return false;
+			}
+		}
+
+	private:
+		Type mType;
+		// Size of integers in bytes, so negative numbers print in their own width in hex
+		size_t mSize;
+		union
+		{
+			int64_t mSigned;
+			uint64_t mUnsigned;
+			double mFloat;
+			const void *mPointer;
+		};
+		std::string_view mString;
+
+		static void writePadded(std::string &output, const FormatSpec &spec, std::string_view prefix, size_t zeros, std::string_view body, bool allowZeroPad)
+		{
+			const size_t length = prefix.size() + zeros + body.size();
+			const size_t fill = static_cast<size_t>(spec.Width) > length ? spec.Width - length : 0;
+			const bool zeroPad = spec.ZeroPad && allowZeroPad && !spec.LeftAlign;
+
+			if (!spec.LeftAlign && !zeroPad)
+				output.append(fill, ' ');
+
+			output.append(prefix);
+			output.append(zeroPad ? fill + zeros : zeros, '0');
+			output.append(body);
+
+			if (spec.LeftAlign)
+				output.append(fill, ' ');
+		}
+
+		static void writeInteger(std::string &output, const FormatSpec &spec, uint64_t magnitude, bool negative, bool isSigned, int base, bool upper)
+		{
+			char digits[64];
+			size_t length = 0;
+			if (magnitude != 0 || spec.Precision != 0)
+				length = std::to_chars(digits, digits + sizeof digits, magnitude, base).ptr - digits;
+
+			if (upper)
+				for (size_t i = 0; i < length; i++)
+					if (digits[i] >= 'a' && digits[i] <= 'f')
+						digits[i] = static_cast<char>(digits[i] - ('a' - 'A'));
+
+			char prefix[2];
+			size_t prefixLength = 0;
+			if (negative)
+				prefix[prefixLength++] = '-';
+			else if (isSigned && spec.Plus)
+				prefix[prefixLength++] = '+';
+			else if (isSigned && spec.Space)
+				prefix[prefixLength++] = ' ';
+
+			if (spec.Alternate && base == 16 && magnitude != 0)
+			{
+				prefix[prefixLength++] = '0';
+				prefix[prefixLength++] = upper ? 'X' : 'x';
+			}
+
+			size_t zeros = spec.Precision > 0 && static_cast<size_t>(spec.Precision) > length ? spec.Precision - length : 0;
+			if (spec.Alternate && base == 8 && zeros == 0 && (length == 0 || digits[0] != '0'))
+				zeros = 1;
+
+			writePadded(output, spec, std::string_view(prefix, prefixLength), zeros, std::string_view(digits, length), spec.Precision < 0);
+		}
+
+		static void writeFloat(std::string &output, const FormatSpec &spec, double value, char conversion)
+		{
+			const bool negative = std::signbit(value);
+			const double magnitude = negative ? -value : value;
+			const bool upper = conversion == 'F' || conversion == 'E' || conversion == 'G' || conversion == 'A';
+
+			// Enough for any double in fixed notation with a reasonable precision
+			char digits[1100];
+			std::to_chars_result result;
+			const int precision = spec.Precision > 512 ? 512 : spec.Precision;
+			switch (conversion)
+			{
+			case 'f': case 'F':
+				result = std::to_chars(digits, digits + sizeof digits, magnitude, std::chars_format::fixed, precision < 0 ? 6 : precision);
+				break;
+			case 'e': case 'E':
+				result = std::to_chars(digits, digits + sizeof digits, magnitude, std::chars_format::scientific, precision < 0 ? 6 : precision);
+				break;
+			case 'g': case 'G':
+				result = std::to_chars(digits, digits + sizeof digits, magnitude, std::chars_format::general, precision < 0 ? 6 : precision);
+				break;
+			case 'a': case 'A':
+				result = precision < 0
+					? std::to_chars(digits, digits + sizeof digits, magnitude, std::chars_format::hex)
+					: std::to_chars(digits, digits + sizeof digits, magnitude, std::chars_format::hex, precision);
+				break;
+			default:
+				// Shortest form that reads back as the same value
+				result = std::to_chars(digits, digits + sizeof digits, magnitude);
+				break;
+			}
+
+			const size_t length = result.ec == std::errc() ? result.ptr - digits : 0;
+			if (upper)
+				for (size_t i = 0; i < length; i++)
+					if (digits[i] >= 'a' && digits[i] <= 'z')
+						digits[i] = static_cast<char>(digits[i] - ('a' - 'A'));
+
+			char prefix[3];
+			size_t prefixLength = 0;
+			if (negative)
+				prefix[prefixLength++] = '-';
+			else if (spec.Plus)
+				prefix[prefixLength++] = '+';
+			else if (spec.Space)
+				prefix[prefixLength++] = ' ';
+
+			const bool finite = std::isfinite(value);
+			if ((conversion == 'a' || conversion == 'A') && finite)
+			{
+				prefix[prefixLength++] = '0';
+				prefix[prefixLength++] = upper ? 'X' : 'x';
+			}
+
+			writePadded(output, spec, std::string_view(prefix, prefixLength), 0, std::string_view(digits, length), finite);
+		}
+
+	public:
+		FormatArgument() : mType(kType_None), mSize(0), mUnsigned(0) { }
+
+		// Arrays are taken as the pointers they decay to
+		template <typename _TValue>
+		FormatArgument(const _TValue &value) : mType(GetType<_TValue>()), mSize(sizeof(std::decay_t<_TValue>)), mUnsigned(0)
+		{
+			using Value = std::decay_t<_TValue>;
+			static_assert(GetType<Value>() != kType_None, "Type cannot be formatted");
+
+			if constexpr (std::is_enum_v<Value>)
+			{
+				if (mType == kType_Signed)
+					mSigned = static_cast<int64_t>(value);
+				else
+					mUnsigned = static_cast<uint64_t>(value);
+			}
+			else if constexpr (std::is_same_v<Value, bool>)
+				mUnsigned = value ? 1 : 0;
+			else if constexpr (std::is_same_v<Value, char>)
+				mSigned = value;
+			else if constexpr (std::is_integral_v<Value>)
+			{
+				if constexpr (std::is_signed_v<Value>)
+					mSigned = value;
+				else
+					mUnsigned = value;
+			}
+			else if constexpr (std::is_floating_point_v<Value>)
+				mFloat = static_cast<double>(value);
+			else if constexpr (std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+				mString = value;
+			else if constexpr (std::is_same_v<Value, const char *> || std::is_same_v<Value, char *>)
+			{
+				const char *string = value;
+				mString = string != nullptr ? std::string_view(string) : std::string_view("(null)");
+			}
+			else
+				mPointer = value;
+		}
+
+		void Write(std::string &output, const FormatSpec &spec) const
+		{
+			char conversion = spec.Conversion;
+
+			switch (mType)
+			{
+			case kType_String:
+			{
+				// The precision limits how much of a string is written
+				std::string_view string = mString;
+				if (spec.Precision >= 0 && string.size() > static_cast<size_t>(spec.Precision))
+					string = string.substr(0, spec.Precision);
+
+				writePadded(output, spec, std::string_view(), 0, string, false);
+				return;
+			}
+			case kType_Pointer:
+				writeInteger(output, {spec.Begin, spec.End, spec.LeftAlign, spec.ZeroPad, false, false, true, spec.Width, spec.Precision, 'x'},
+					reinterpret_cast<uintptr_t>(mPointer), false, false, 16, false);
+				return;
+			case kType_Float:
+				writeFloat(output, spec, mFloat, conversion);
+				return;
+			case kType_None:
+				return;
+			default:
+				break;
+			}
+
+			// Integers, characters and booleans
+			if (conversion == 'c' || (conversion == 's' && mType == kType_Char))
+			{
+				const char character = static_cast<char>(mUnsigned);
+				writePadded(output, spec, std::string_view(), 0, std::string_view(&character, 1), false);
+			}
+			else if (conversion == 's' && mType == kType_Bool)
+			{
+				writePadded(output, spec, std::string_view(), 0, mUnsigned != 0 ? "true" : "false", false);
+			}
+			else if (conversion == 'f' || conversion == 'F' || conversion == 'e' || conversion == 'E' ||
+				conversion == 'g' || conversion == 'G' || conversion == 'a' || conversion == 'A')
+			{
+				writeFloat(output, spec, mType == kType_Signed || mType == kType_Char ? static_cast<double>(mSigned) : static_cast<double>(mUnsigned), conversion);
+			}
+			else if (conversion == 'o' || conversion == 'x' || conversion == 'X')
+			{
+				// Like printf, negative numbers are shown as their two's complement
+				uint64_t value = mUnsigned;
+				if (mSize < sizeof(uint64_t))
+					value &= (uint64_t(1) << (mSize * 8)) - 1;
+
+				writeInteger(output, spec, value, false, false, conversion == 'o' ? 8 : 16, conversion == 'X');
+			}
+			else if (mType == kType_Signed || mType == kType_Char)
+			{
+				const bool negative = mSigned < 0;
+				const uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(mSigned) : static_cast<uint64_t>(mSigned);
+				writeInteger(output, spec, magnitude, negative, true, 10, false);
+			}
+			else
+			{
+				writeInteger(output, spec, mUnsigned, false, false, 10, false);
+			}
+		}
+	};
+
+	// A printf style format string, parsed and checked against the argument types
+	// up front. A mismatch between the conversions and the arguments is a compile
+	// error with consteval (C++20). Without it nothing is dropped: an argument that
+	// does not match its conversion is formatted by its own type, as with %s, a
+	// conversion without an argument is written as it stands, and arguments left
+	// over, for example after a malformed conversion, are appended to the end,
+	// each after a space. Length modifiers (l, ll, z, ...) are accepted and
+	// ignored, since the argument types are known.
+	template <typename... _TArgs>
+	class FormatString
+	{
+		static constexpr size_t kCount = sizeof...(_TArgs);
+		static constexpr FormatArgument::Type kTypes[kCount + 1] = {FormatArgument::GetType<_TArgs>()..., FormatArgument::kType_None};
+
+		std::string_view mFormat;
+		FormatSpec mSpecs[kCount + 1] = {};
+		size_t mCount = 0;
+
+		// Not constexpr, so reaching it while compiling fails the build; at run time
+		// the caller recovers as described above
+		static void formatStringError(const char *) { }
+
+		static constexpr bool isDigit(char character)
+		{
+			return character >= '0' && character <= '9';
+		}
+
+		constexpr void parse()
+		{
+			const std::string_view format = mFormat;
+			for (size_t i = 0; i < format.size(); i++)
+			{
+				if (format[i] != '%')
+					continue;
+
+				if (i + 1 < format.size() && format[i + 1] == '%')
+				{
+					i++;
+					continue;
+				}
+
+				FormatSpec spec;
+				spec.Begin = i;
+
+				size_t j = i + 1;
+				for (; j < format.size(); j++)
+				{
+					const char flag = format[j];
+					if (flag == '-')
+						spec.LeftAlign = true;
+					else if (flag == '0')
+						spec.ZeroPad = true;
+					else if (flag == '+')
+						spec.Plus = true;
+					else if (flag == ' ')
+						spec.Space = true;
+					else if (flag == '#')
+						spec.Alternate = true;
+					else
+						break;
+				}
+
+				for (; j < format.size() && isDigit(format[j]); j++)
+					spec.Width = spec.Width * 10 + (format[j] - '0');
+
+				if (j < format.size() && format[j] == '.')
+				{
+					spec.Precision = 0;
+					for (j++; j < format.size() && isDigit(format[j]); j++)
+						spec.Precision = spec.Precision * 10 + (format[j] - '0');
+				}
+
+				if (j < format.size() && format[j] == '*')
+				{
+					formatStringError("Width and precision must be part of the format string");
+					return;
+				}
+
+				while (j < format.size() && (format[j] == 'h' || format[j] == 'l' || format[j] == 'L' || format[j] == 'z' ||
+					format[j] == 'j' || format[j] == 't' || format[j] == 'q'))
+					j++;
+
+				if (j >= format.size())
+				{
+					formatStringError("Format string ends in the middle of a conversion");
+					return;
+				}
+
+				spec.Conversion = format[j];
+				spec.End = j + 1;
+
+				if (mCount == kCount)
+				{
+					formatStringError("More conversions than arguments");
+					return;
+				}
+
+				// %s takes every type and writes it in its natural form
+				if (!FormatArgument::IsCompatible(spec.Conversion, kTypes[mCount]))
+				{
+					formatStringError("Conversion does not match the argument type");
+					spec.Conversion = 's';
+				}
+
+				mSpecs[mCount++] = spec;
+				i = j;
+			}
+
+			if (mCount != kCount)
+				formatStringError("Fewer conversions than arguments");
+		}
+
+	public:
+		INDIGO_CONSTEVAL FormatString(const char *format) : mFormat(format)
+		{
+			parse();
+		}
+
+		// Format strings only known at runtime
+		FormatString(std::string_view format) : mFormat(format)
+		{
+			parse();
+		}
+
+		FormatString(const std::string &format) : mFormat(format)
+		{
+			parse();
+		}
+
+		std::string_view GetFormat() const
+		{
+			return mFormat;
+		}
+
+		const FormatSpec *GetSpecs() const
+		{
+			return mSpecs;
+		}
+
+		size_t GetCount() const
+		{
+			return mCount;
+		}
+	};
+
+	// Type-safe printf style formatting. Numbers are written with to_chars straight
+	// into the output, so every call is a single pass and appending to a reused
+	// string does not allocate once it has grown.
+	// Example:
+	//    std::string line = Formatter::Format("%s: %s", name, value);
+	//    ...
+	//    buffer.clear();
+	//    Formatter::FormatTo(buffer, "%08.3f|%-6d|%x", 3.14159, 42, 255u);
+	class Formatter
+	{
+		static void appendLiteral(std::string &output, std::string_view literal)
+		{
+			for (;;)
+			{
+				const size_t percent = literal.find('%');
+				if (percent == std::string_view::npos)
+					break;
+
+				// "%%" is written as a single '%'
+				const size_t length = percent + 1 < literal.size() && literal[percent + 1] == '%' ? percent + 2 : percent + 1;
+				output.append(literal.data(), percent + 1);
+				literal.remove_prefix(length);
+			}
+
+			output.append(literal);
+		}
+
+	public:
+		static void FormatTo(std::string &output, std::string_view format, const FormatSpec *specs, size_t specCount, const FormatArgument *arguments, size_t argumentCount)
+		{
+			size_t position = 0;
+			for (size_t i = 0; i < specCount; i++)
+			{
+				const FormatSpec &spec = specs[i];
+				appendLiteral(output, format.substr(position, spec.Begin - position));
+
+				if (i < argumentCount)
+					arguments[i].Write(output, spec);
+				else
+					output.append(format.substr(spec.Begin, spec.End - spec.Begin));
+
+				position = spec.End;
+			}
+
+			appendLiteral(output, format.substr(position));
+
+			// Arguments the format string has no conversion for
+			FormatSpec spec;
+			spec.Conversion = 's';
+			for (size_t i = specCount; i < argumentCount; i++)
+			{
+				output.push_back(' ');
+				arguments[i].Write(output, spec);
+			}
+		}
+
+		// Appends to output
+		template <typename... _TArgs>
+		static void FormatTo(std::string &output, FormatString<std::decay_t<_TArgs>...> format, const _TArgs &... arguments)
+		{
+			const FormatArgument erased[sizeof...(_TArgs) + 1] = {FormatArgument(arguments)..., FormatArgument()};
+			FormatTo(output, format.GetFormat(), format.GetSpecs(), format.GetCount(), erased, sizeof...(_TArgs));
+		}
+
+		template <typename... _TArgs>
+		static std::string Format(FormatString<std::decay_t<_TArgs>...> format, const _TArgs &... arguments)
+		{
+			std::string output;
+			output.reserve(format.GetFormat().size() + sizeof...(_TArgs) * 8);
+			FormatTo(output, format, arguments...);
+			return output;
+		}
+	};
+}
+
+#endif // indigo_format_hpp_
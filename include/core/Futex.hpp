@@ -0,0 +1,180 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_futex_hpp_
+#define indigo_futex_hpp_
+
+#include "../Platform.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#if defined(OS_LINUX)
+#include <linux/futex.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#elif defined(OS_WIN)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace indigo
+{
+	// Wait and wake on a 32-bit word, the building block for the synchronization
+	// primitives in core. Uses futex on Linux and WaitOnAddress on Windows, and
+	// falls back to hashed mutex/condition variable pairs elsewhere. Waits may
+	// return spuriously, so callers always recheck their condition.
+	class Futex
+	{
+#if !defined(OS_LINUX) && !defined(OS_WIN)
+		struct Bucket
+		{
+			std::mutex Mutex;
+			std::condition_variable Condition;
+		};
+
+		static Bucket &getBucket(const void *address)
+		{
+			static Bucket buckets[64];
+			return buckets[(reinterpret_cast<uintptr_t>(address) >> 4) % 64];
+		}
+#endif
+
+	public:
+		// Blocks while word still holds expected. A negative timeout waits forever.
+		// Returns false if the timeout expired.
+		static bool Wait(std::atomic<uint32_t> &word, uint32_t expected, int64_t timeoutNanoseconds = -1)
+		{
+#if defined(OS_LINUX)
+			timespec timeout;
+			timespec *timeoutPtr = nullptr;
+			if (timeoutNanoseconds >= 0)
+			{
+				timeout.tv_sec = static_cast<time_t>(timeoutNanoseconds / 1000000000);
+				timeout.tv_nsec = static_cast<long>(timeoutNanoseconds % 1000000000);
+				timeoutPtr = &timeout;
+			}
+
+			const long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, timeoutPtr, nullptr, 0);
+			return result == 0 || errno != ETIMEDOUT;
+#elif defined(OS_WIN)
+			DWORD milliseconds = INFINITE;
+			if (timeoutNanoseconds >= 0)
+				milliseconds = static_cast<DWORD>((timeoutNanoseconds + 999999) / 1000000);
+
+			return WaitOnAddress(&word, &expected, sizeof(expected), milliseconds) || GetLastError() != ERROR_TIMEOUT;
+#else
+			Bucket &bucket = getBucket(&word);
+			std::unique_lock<std::mutex> lock(bucket.Mutex);
+			if (word.load() != expected)
+				return true;
+
+			if (timeoutNanoseconds < 0)
+			{
+				bucket.Condition.wait(lock);
+				return true;
+			}
+
+			return bucket.Condition.wait_for(lock, std::chrono::nanoseconds(timeoutNanoseconds)) != std::cv_status::timeout;
+#endif
+		}
+
+		static void WakeOne(std::atomic<uint32_t> &word)
+		{
+#if defined(OS_LINUX)
+			syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif defined(OS_WIN)
+			WakeByAddressSingle(&word);
+#else
+			// Buckets are shared between words, so everyone has to recheck
+			WakeAll(word);
+#endif
+		}
+
+		static void WakeAll(std::atomic<uint32_t> &word)
+		{
+#if defined(OS_LINUX)
+			syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#elif defined(OS_WIN)
+			WakeByAddressAll(&word);
+#else
+			Bucket &bucket = getBucket(&word);
+			std::lock_guard<std::mutex> lock(bucket.Mutex);
+			bucket.Condition.notify_all();
+#endif
+		}
+
+		// How long to spin before parking: spinning only helps when the thread that
+		// will release us can run at the same time, so never on a single CPU
+		static uint32_t GetSpinCount(uint32_t count)
+		{
+			static const bool singleCpu = std::thread::hardware_concurrency() == 1;
+			return singleCpu ? 0 : count;
+		}
+
+		// Tells the CPU we are in a spin-wait loop
+		static void Pause()
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			_mm_pause();
+#elif defined(__aarch64__)
+			__asm__ __volatile__("yield");
+#endif
+		}
+	};
+
+	// Turns a relative timeout in milliseconds (0 meaning forever, like
+	// ManualReset::Wait) into a deadline and hands out what is left of it
+	class FutexDeadline
+	{
+		std::chrono::steady_clock::time_point mDeadline;
+		bool mInfinite;
+
+	public:
+		explicit FutexDeadline(int timeout)
+			: mDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout)), mInfinite(timeout == 0) { }
+
+		bool IsInfinite() const
+		{
+			return mInfinite;
+		}
+
+		// Nanoseconds left, -1 when waiting forever and 0 once expired
+		int64_t GetRemaining() const
+		{
+			if (mInfinite)
+				return -1;
+
+			const auto remaining = mDeadline - std::chrono::steady_clock::now();
+			if (remaining.count() <= 0)
+				return 0;
+
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+		}
+	};
+}
+
+#endif // indigo_futex_hpp_
@@ -0,0 +1,155 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_inline_function_hpp_
+#define indigo_inline_function_hpp_
+
+// Required libraries
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+#ifndef INDIGO_CORE_FUNCTION_BUFFERSIZE
+#define INDIGO_CORE_FUNCTION_BUFFERSIZE 64
+#endif // INDIGO_CORE_FUNCTION_BUFFERSIZE
+
+namespace indigo
+{
+	template <typename _TSignature, size_t _Size = INDIGO_CORE_FUNCTION_BUFFERSIZE>
+	class InlineFunction;
+
+	// Move-only replacement for std::function which stores the callable in a fixed
+	// buffer inside the object, so it never allocates. Callables which do not fit
+	// are rejected at compile time; capture large state by pointer or reference,
+	// or raise the buffer size.
+	// Example:
+	//    InlineFunction<void(int)> function = [&total](int value) { total += value; };
+	//    function(5);
+	template <typename _TResult, typename... _TArgs, size_t _Size>
+	class InlineFunction<_TResult(_TArgs ...), _Size>
+	{
+		// Per callable type operations, shared by every function holding that type
+		struct Operations
+		{
+			_TResult (*Invoke)(void *storage, _TArgs &&... arguments);
+			void (*Move)(void *destination, void *source);
+			void (*Destroy)(void *storage);
+		};
+
+		template <typename _TFunction>
+		struct OperationsFor
+		{
+			static _TResult Invoke(void *storage, _TArgs &&... arguments)
+			{
+				return (*static_cast<_TFunction *>(storage))(std::forward<_TArgs>(arguments)...);
+			}
+
+			static void Move(void *destination, void *source)
+			{
+				new (destination) _TFunction(std::move(*static_cast<_TFunction *>(source)));
+				static_cast<_TFunction *>(source)->~_TFunction();
+			}
+
+			static void Destroy(void *storage)
+			{
+				static_cast<_TFunction *>(storage)->~_TFunction();
+			}
+
+			static const Operations Table;
+		};
+
+		typename std::aligned_storage<_Size, alignof(std::max_align_t)>::type mStorage;
+		const Operations *mOperations;
+
+	public:
+		InlineFunction() noexcept : mOperations(nullptr) { }
+		InlineFunction(std::nullptr_t) noexcept : mOperations(nullptr) { }
+
+		template <typename _TFunction, typename _TDecayed = typename std::decay<_TFunction>::type,
+		          typename = typename std::enable_if<!std::is_same<_TDecayed, InlineFunction>::value>::type>
+		InlineFunction(_TFunction &&function)
+			: mOperations(&OperationsFor<_TDecayed>::Table)
+		{
+			static_assert(sizeof(_TDecayed) <= _Size, "Callable does not fit in the InlineFunction buffer");
+			static_assert(alignof(_TDecayed) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+
+			new (&mStorage) _TDecayed(std::forward<_TFunction>(function));
+		}
+
+		InlineFunction(InlineFunction &&other) noexcept
+			: mOperations(other.mOperations)
+		{
+			if (mOperations != nullptr)
+			{
+				mOperations->Move(&mStorage, &other.mStorage);
+				other.mOperations = nullptr;
+			}
+		}
+
+		InlineFunction(const InlineFunction &) = delete;
+		InlineFunction &operator=(const InlineFunction &) = delete;
+
+		~InlineFunction()
+		{
+			Reset();
+		}
+
+		InlineFunction &operator=(InlineFunction &&other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				if (other.mOperations != nullptr)
+				{
+					other.mOperations->Move(&mStorage, &other.mStorage);
+					mOperations = other.mOperations;
+					other.mOperations = nullptr;
+				}
+			}
+
+			return *this;
+		}
+
+		InlineFunction &operator=(std::nullptr_t) noexcept
+		{
+			Reset();
+			return *this;
+		}
+
+		void Reset() noexcept
+		{
+			if (mOperations != nullptr)
+			{
+				mOperations->Destroy(&mStorage);
+				mOperations = nullptr;
+			}
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return mOperations != nullptr;
+		}
+
+		_TResult operator()(_TArgs ... arguments)
+		{
+			return mOperations->Invoke(&mStorage, std::forward<_TArgs>(arguments)...);
+		}
+	};
+
+	template <typename _TResult, typename... _TArgs, size_t _Size>
+	template <typename _TFunction>
+	const typename InlineFunction<_TResult(_TArgs ...), _Size>::Operations
+	InlineFunction<_TResult(_TArgs ...), _Size>::OperationsFor<_TFunction>::Table = {
+		&OperationsFor<_TFunction>::Invoke,
+		&OperationsFor<_TFunction>::Move,
+		&OperationsFor<_TFunction>::Destroy
+	};
+}
+
+#endif // indigo_inline_function_hpp_
@@ -0,0 +1,82 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_latch_hpp_
+#define indigo_latch_hpp_
+
+#include "Futex.hpp"
+
+namespace indigo
+{
+	// Single-use countdown: waiters are released once the count reaches zero
+	// Example:
+	//    Latch latch(workers.size());
+	//    for (auto &worker : workers)
+	//        worker.Run([&]() { ...; latch.CountDown(); });
+	//    latch.Wait();
+	class Latch
+	{
+		static const uint32_t kSpin = 256;
+
+		std::atomic<uint32_t> mCount;
+
+	public:
+		explicit Latch(uint32_t count)
+			: mCount(count) { }
+
+		Latch(const Latch &) = delete;
+		Latch &operator=(const Latch &) = delete;
+
+		void CountDown(uint32_t count = 1)
+		{
+			// Waiters park on the count itself and only the final count down wakes them
+			if (mCount.fetch_sub(count, std::memory_order_acq_rel) == count)
+				Futex::WakeAll(mCount);
+		}
+
+		bool TryWait() const
+		{
+			return mCount.load(std::memory_order_acquire) == 0;
+		}
+
+		// Timeout in milliseconds, 0 waits forever. Returns false if the timeout expired.
+		bool Wait(int timeout = 0)
+		{
+			const uint32_t spin = Futex::GetSpinCount(kSpin);
+			for (uint32_t i = 0; i < spin; i++)
+			{
+				if (TryWait())
+					return true;
+
+				Futex::Pause();
+			}
+
+			const FutexDeadline deadline(timeout);
+			for (;;)
+			{
+				const uint32_t count = mCount.load(std::memory_order_acquire);
+				if (count == 0)
+					return true;
+
+				const int64_t remaining = deadline.GetRemaining();
+				if (remaining == 0)
+					return false;
+
+				Futex::Wait(mCount, count, remaining);
+			}
+		}
+
+		void ArriveAndWait(uint32_t count = 1)
+		{
+			CountDown(count);
+			Wait();
+		}
+	};
+}
+
+#endif // indigo_latch_hpp_
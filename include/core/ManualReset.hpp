@@ -9,46 +9,40 @@
 #ifndef indigo_manual_reset_hpp_
 #define indigo_manual_reset_hpp_
 
-#include <mutex>
-#include <condition_variable>
+#include "WaitHandle.hpp"
 
 namespace indigo
 {
-	class ManualReset
+	// Stays signaled until Reset, releasing every waiter
+	class ManualReset : public WaitHandle
 	{
-		std::mutex mMutex;
-		std::condition_variable mConditionVariable;
-		bool mSignaled;
+	protected:
+		bool consume(bool) override
+		{
+			return true;
+		}
+
+		void release() override { }
 
 	public:
 		explicit ManualReset(bool initialState = false)
-			: mSignaled(initialState) { }
+			: WaitHandle(initialState) { }
 
 		void Set()
 		{
-			std::unique_lock<std::mutex> lock(mMutex);
-			mSignaled = true;
-			mConditionVariable.notify_all();
+			signal(true);
 		}
 
 		void Reset()
 		{
-			std::unique_lock<std::mutex> lock(mMutex);
-			mSignaled = false;
+			uint32_t signaled = kState_Signaled;
+			mState.compare_exchange_strong(signaled, kState_Unsignaled, std::memory_order_acq_rel);
 		}
 
+		// Timeout in milliseconds, 0 waits forever. Returns false if the timeout expired.
 		bool Wait(int timeout = 0)
 		{
-			std::unique_lock<std::mutex> lock(mMutex);
-			while (!mSignaled)
-			{
-				if (timeout == 0)
-					mConditionVariable.wait(lock);
-				else
-					return mConditionVariable.wait_for(lock, std::chrono::milliseconds(timeout)) != std::cv_status::timeout;
-			}
-
-			return true;
+			return wait(timeout);
 		}
 	};
 }
@@ -0,0 +1,142 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_read_write_spin_lock_hpp_
+#define indigo_read_write_spin_lock_hpp_
+
+#include "Futex.hpp"
+
+namespace indigo
+{
+	// Reader-writer lock for short critical sections. A waiting writer keeps new
+	// readers out, so writers cannot starve. Contended threads spin first and then
+	// park on the lock word.
+	// Example:
+	//    ReadWriteSpinLock lock;
+	//    std::shared_lock<ReadWriteSpinLock> reader(lock);
+	class ReadWriteSpinLock
+	{
+		static const uint32_t kSpin = 1024;
+
+		// Bit 31 is set while a writer holds the lock, bits 16-30 count waiting
+		// writers and bits 0-15 count the readers holding the lock
+		static const uint32_t kWriter = 0x80000000;
+		static const uint32_t kWriterWaiting = 0x00010000;
+		static const uint32_t kWritersWaitingMask = 0x7FFF0000;
+		static const uint32_t kReadersMask = 0x0000FFFF;
+
+		std::atomic<uint32_t> mState;
+		std::atomic<uint32_t> mParked;
+
+		void wake()
+		{
+			if (mParked.load(std::memory_order_seq_cst) != 0)
+				Futex::WakeAll(mState);
+		}
+
+		template <typename _TPredicate>
+		void park(uint32_t &spin, uint32_t state, _TPredicate isBlocked)
+		{
+			if (spin < Futex::GetSpinCount(kSpin))
+			{
+				spin++;
+				Futex::Pause();
+				return;
+			}
+
+			mParked.fetch_add(1, std::memory_order_seq_cst);
+			if (isBlocked(mState.load(std::memory_order_seq_cst)))
+				Futex::Wait(mState, state);
+			mParked.fetch_sub(1, std::memory_order_seq_cst);
+		}
+
+	public:
+		ReadWriteSpinLock() : mState(0), mParked(0) { }
+
+		ReadWriteSpinLock(const ReadWriteSpinLock &) = delete;
+		ReadWriteSpinLock &operator=(const ReadWriteSpinLock &) = delete;
+
+		bool TryLockShared()
+		{
+			uint32_t state = mState.load(std::memory_order_relaxed);
+			return (state & (kWriter | kWritersWaitingMask)) == 0
+				&& mState.compare_exchange_strong(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+
+		void LockShared()
+		{
+			uint32_t spin = 0;
+			for (;;)
+			{
+				uint32_t state = mState.load(std::memory_order_relaxed);
+				if ((state & (kWriter | kWritersWaitingMask)) == 0)
+				{
+					if (mState.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed))
+						return;
+
+					continue;
+				}
+
+				park(spin, state, [](uint32_t current) { return (current & (kWriter | kWritersWaitingMask)) != 0; });
+			}
+		}
+
+		void UnlockShared()
+		{
+			// The last reader lets a waiting writer in
+			if ((mState.fetch_sub(1, std::memory_order_seq_cst) & kReadersMask) == 1)
+				wake();
+		}
+
+		bool TryLock()
+		{
+			uint32_t state = mState.load(std::memory_order_relaxed);
+			return (state & (kWriter | kReadersMask)) == 0
+				&& mState.compare_exchange_strong(state, state | kWriter, std::memory_order_acquire, std::memory_order_relaxed);
+		}
+
+		void Lock()
+		{
+			if (TryLock())
+				return;
+
+			mState.fetch_add(kWriterWaiting, std::memory_order_relaxed);
+
+			uint32_t spin = 0;
+			for (;;)
+			{
+				uint32_t state = mState.load(std::memory_order_relaxed);
+				if ((state & (kWriter | kReadersMask)) == 0)
+				{
+					if (mState.compare_exchange_weak(state, (state - kWriterWaiting) | kWriter, std::memory_order_acquire, std::memory_order_relaxed))
+						return;
+
+					continue;
+				}
+
+				park(spin, state, [](uint32_t current) { return (current & (kWriter | kReadersMask)) != 0; });
+			}
+		}
+
+		void Unlock()
+		{
+			mState.fetch_and(~kWriter, std::memory_order_seq_cst);
+			wake();
+		}
+
+		// Lockable and SharedLockable, for std::lock_guard and std::shared_lock
+		void lock() { Lock(); }
+		void unlock() { Unlock(); }
+		bool try_lock() { return TryLock(); }
+		void lock_shared() { LockShared(); }
+		void unlock_shared() { UnlockShared(); }
+		bool try_lock_shared() { return TryLockShared(); }
+	};
+}
+
+#endif // indigo_read_write_spin_lock_hpp_
@@ -0,0 +1,102 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_semaphore_hpp_
+#define indigo_semaphore_hpp_
+
+#include "Futex.hpp"
+
+namespace indigo
+{
+	// Counting semaphore. Releasing only enters the kernel when a thread is parked
+	// and the count was zero.
+	class Semaphore
+	{
+		static const uint32_t kSpin = 256;
+
+		std::atomic<uint32_t> mCount;
+		std::atomic<uint32_t> mWaiters;
+
+	public:
+		explicit Semaphore(uint32_t initialCount = 0)
+			: mCount(initialCount), mWaiters(0) { }
+
+		Semaphore(const Semaphore &) = delete;
+		Semaphore &operator=(const Semaphore &) = delete;
+
+		void Release(uint32_t count = 1)
+		{
+			// Only the release that makes the count nonzero wakes anyone; each waiter
+			// that gets through wakes the next one while the count stays above zero,
+			// so a burst of releases costs one wake instead of one per release
+			const uint32_t previous = mCount.fetch_add(count, std::memory_order_seq_cst);
+			if (previous != 0 || mWaiters.load(std::memory_order_seq_cst) == 0)
+				return;
+
+			if (count == 1)
+				Futex::WakeOne(mCount);
+			else
+				Futex::WakeAll(mCount);
+		}
+
+		bool TryAcquire()
+		{
+			uint32_t count = mCount.load(std::memory_order_relaxed);
+			while (count != 0)
+			{
+				if (mCount.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+					return true;
+			}
+
+			return false;
+		}
+
+		// Timeout in milliseconds, 0 waits forever. Returns false if the timeout expired.
+		bool Acquire(int timeout = 0)
+		{
+			const uint32_t spin = Futex::GetSpinCount(kSpin);
+			for (uint32_t i = 0; i < spin; i++)
+			{
+				if (TryAcquire())
+					return true;
+
+				Futex::Pause();
+			}
+
+			const FutexDeadline deadline(timeout);
+			mWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+			bool acquired;
+			for (;;)
+			{
+				acquired = TryAcquire();
+				if (acquired)
+					break;
+
+				const int64_t remaining = deadline.GetRemaining();
+				if (remaining == 0)
+					break;
+
+				Futex::Wait(mCount, 0, remaining);
+			}
+
+			mWaiters.fetch_sub(1, std::memory_order_seq_cst);
+			if (acquired && mCount.load(std::memory_order_seq_cst) != 0 && mWaiters.load(std::memory_order_seq_cst) != 0)
+				Futex::WakeOne(mCount);
+
+			return acquired;
+		}
+
+		uint32_t GetCount() const
+		{
+			return mCount.load(std::memory_order_relaxed);
+		}
+	};
+}
+
+#endif // indigo_semaphore_hpp_
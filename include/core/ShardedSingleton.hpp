@@ -0,0 +1,129 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_sharded_singleton_hpp_
+#define indigo_sharded_singleton_hpp_
+
+#include "../Platform.hpp"
+#include <memory>
+#include <thread>
+#include <functional>
+
+#if defined(OS_LINUX)
+#include <sched.h>
+#elif defined(OS_WIN)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace indigo
+{
+	// One instance per CPU, each on its own cache line, for counters and caches that
+	// every thread hits. Threads use the instance of the CPU they run on, so access
+	// is uncontended in practice, but a thread can migrate or be preempted while
+	// using it: the instances still have to be thread safe (relaxed atomics are
+	// usually enough). Aggregate folds all instances into one result.
+	// Example:
+	//    struct Counter { std::atomic<uint64_t> Value{0}; };
+	//    ShardedSingleton<Counter>::GetLocal().Value.fetch_add(1, std::memory_order_relaxed);
+	//    ...
+	//    uint64_t total = ShardedSingleton<Counter>::Aggregate<uint64_t>(0, [](uint64_t sum, const Counter &counter) {
+	//        return sum + counter.Value.load(std::memory_order_relaxed);
+	//    });
+	template <typename _TClass>
+	class ShardedSingleton
+	{
+		struct alignas(64) Shard
+		{
+			_TClass Instance;
+		};
+
+		struct Shards
+		{
+			std::unique_ptr<Shard[]> Items;
+			size_t Count;
+
+			Shards()
+			{
+				const unsigned int count = std::thread::hardware_concurrency();
+				Count = count == 0 ? 1 : count;
+				Items.reset(new Shard[Count]);
+			}
+		};
+
+		static Shards &getShards()
+		{
+			static Shards shards;
+			return shards;
+		}
+
+		static size_t getCurrentCpu()
+		{
+#if defined(OS_LINUX)
+			const int cpu = sched_getcpu();
+			if (cpu >= 0)
+				return static_cast<size_t>(cpu);
+#elif defined(OS_WIN)
+			return static_cast<size_t>(GetCurrentProcessorNumber());
+#endif
+			return std::hash<std::thread::id>()(std::this_thread::get_id());
+		}
+
+	public:
+		// Instance of the CPU the calling thread is running on
+		static _TClass &GetLocal()
+		{
+			// With one CPU there is nothing to spread, so skip asking for it
+			Shards &shards = getShards();
+			if (shards.Count == 1)
+				return shards.Items[0].Instance;
+
+			return shards.Items[getCurrentCpu() % shards.Count].Instance;
+		}
+
+		static _TClass &GetShard(size_t index)
+		{
+			return getShards().Items[index].Instance;
+		}
+
+		static size_t GetShardCount()
+		{
+			return getShards().Count;
+		}
+
+		// Calls fold(result, instance) for every instance, feeding each result into the next call
+		template <typename _TResult, typename _TFold>
+		static _TResult Aggregate(_TResult initial, _TFold fold)
+		{
+			Shards &shards = getShards();
+			for (size_t i = 0; i < shards.Count; i++)
+				initial = fold(std::move(initial), static_cast<const _TClass &>(shards.Items[i].Instance));
+
+			return initial;
+		}
+
+		template <typename _TFunction>
+		static void ForEach(_TFunction function)
+		{
+			Shards &shards = getShards();
+			for (size_t i = 0; i < shards.Count; i++)
+				function(shards.Items[i].Instance);
+		}
+
+		ShardedSingleton() { }
+		explicit ShardedSingleton(_TClass const &) = delete;
+		void operator=(_TClass const &) = delete;
+	};
+}
+
+#endif // indigo_sharded_singleton_hpp_
@@ -9,6 +9,7 @@
 #ifndef indigo_sys_function_hpp_
 #define indigo_sys_function_hpp_
 
+#include "StaticInitializer.hpp"
 #include <functional>
 
 namespace indigo
@@ -29,6 +30,15 @@ namespace indigo
 			startup_function();
 		}
 
+		// Registers the functions with StaticInitializer instead of running them, so they
+		// run in dependency order (and in parallel where possible) during
+		// StaticInitializer::Startup and Shutdown
+		StaticFunction(std::string name, std::vector<std::string> dependencies, std::function<void()> startupFunction,
+		               std::function<void()> shutdownFunction = std::function<void()>())
+		{
+			StaticInitializer::GetInstance().Register(std::move(name), std::move(dependencies), std::move(startupFunction), std::move(shutdownFunction));
+		}
+
 		~StaticFunction()
 		{
 			if (mShutdownFunction)
@@ -0,0 +1,342 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_static_initializer_hpp_
+#define indigo_static_initializer_hpp_
+
+// Required libraries
+#include "ThreadPool.hpp"
+#include "Latch.hpp"
+#include "Singleton.hpp"
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+namespace indigo
+{
+	// Registry of named startup and shutdown functions with dependencies between
+	// them. Startup runs every function once its dependencies are done, spreading
+	// independent ones over a thread pool, so startup takes about as long as the
+	// slowest chain of dependencies. Shutdown runs in reverse dependency order.
+	// Example:
+	//    static StaticFunction sLogger("Logger", {}, []() { ... });
+	//    static StaticFunction sConfig("Config", {"Logger"}, []() { ... }, []() { ... });
+	//    ...
+	//    StaticInitializer::GetInstance().Startup();
+	//    ...
+	//    StaticInitializer::GetInstance().Shutdown();
+	class StaticInitializer
+	{
+	public:
+		struct Timing
+		{
+			std::string Name;
+			// Time since Startup/Shutdown began when the function started
+			std::chrono::nanoseconds Start;
+			std::chrono::nanoseconds Duration;
+		};
+
+	private:
+		struct Entry
+		{
+			std::string Name;
+			std::vector<std::string> Dependencies;
+			std::function<void()> Startup;
+			std::function<void()> Shutdown;
+
+			// Filled in while scheduling
+			std::vector<size_t> Edges;
+			std::atomic<size_t> Remaining;
+			std::atomic<bool> Failed;
+			bool Started;
+			Timing Result;
+		};
+
+		// Scheduling state of one Startup or Shutdown
+		struct Run
+		{
+			std::vector<Entry *> Entries;
+			bool Shutdown;
+			std::chrono::steady_clock::time_point Begin;
+			ThreadPool *Pool;
+			Latch Done;
+
+			Run(std::vector<Entry *> &entries, bool shutdown, ThreadPool *pool)
+				: Shutdown(shutdown), Begin(std::chrono::steady_clock::now()), Pool(pool), Done(static_cast<uint32_t>(entries.size()))
+			{
+				Entries.swap(entries);
+			}
+		};
+
+		// mMutex guards the registry and is never held while functions run, so
+		// they can register more; mRunMutex keeps Startup and Shutdown apart
+		std::mutex mMutex;
+		std::mutex mRunMutex;
+		std::vector<std::unique_ptr<Entry>> mEntries;
+		bool mStarted;
+		std::vector<Timing> mStartupTimings;
+		std::vector<Timing> mShutdownTimings;
+
+		// Links every entry to the entries that have to wait for it (reverse = false)
+		// or that it has to wait for (reverse = true). Fails on unknown dependencies
+		// and cycles.
+		static bool link(std::vector<Entry *> &entries, bool reverse)
+		{
+			std::map<std::string, size_t> indices;
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				entries[i]->Edges.clear();
+				entries[i]->Remaining = 0;
+				entries[i]->Failed = false;
+				entries[i]->Result = {entries[i]->Name, std::chrono::nanoseconds(0), std::chrono::nanoseconds(0)};
+				indices[entries[i]->Name] = i;
+			}
+
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				for (auto &dependency : entries[i]->Dependencies)
+				{
+					auto found = indices.find(dependency);
+					if (found == indices.end())
+						return false;
+
+					const size_t from = reverse ? i : found->second;
+					const size_t to = reverse ? found->second : i;
+					entries[from]->Edges.push_back(to);
+					entries[to]->Remaining++;
+				}
+			}
+
+			// Kahn's algorithm on a copy of the counters to reject cycles up front
+			std::vector<size_t> remaining, ready;
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				remaining.push_back(entries[i]->Remaining);
+				if (remaining[i] == 0)
+					ready.push_back(i);
+			}
+
+			size_t visited = 0;
+			while (!ready.empty())
+			{
+				const size_t current = ready.back();
+				ready.pop_back();
+				visited++;
+
+				for (size_t next : entries[current]->Edges)
+					if (--remaining[next] == 0)
+						ready.push_back(next);
+			}
+
+			return visited == entries.size();
+		}
+
+		static void runEntry(Run &run, size_t index)
+		{
+			Entry &entry = *run.Entries[index];
+
+			// Only what started successfully gets shut down
+			const auto start = std::chrono::steady_clock::now();
+			if (!entry.Failed && (!run.Shutdown || entry.Started))
+			{
+				try
+				{
+					const auto &function = run.Shutdown ? entry.Shutdown : entry.Startup;
+					if (function)
+						function();
+				}
+				catch (...)
+				{
+					entry.Failed = true;
+				}
+
+				entry.Started = !run.Shutdown && !entry.Failed;
+			}
+			const auto end = std::chrono::steady_clock::now();
+
+			entry.Result.Start = start - run.Begin;
+			entry.Result.Duration = end - start;
+
+			for (size_t next : entry.Edges)
+			{
+				// Everything that depends on a failed startup is skipped
+				if (entry.Failed && !run.Shutdown)
+					run.Entries[next]->Failed = true;
+
+				if (run.Entries[next]->Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					schedule(run, next);
+			}
+
+			run.Done.CountDown();
+		}
+
+		static void schedule(Run &run, size_t index)
+		{
+			if (run.Pool != nullptr)
+				run.Pool->Submit([&run, index]() { runEntry(run, index); });
+			else
+				runEntry(run, index);
+		}
+
+		// Runs the entries linked by link, without holding mMutex
+		static bool run(std::vector<Entry *> &entries, bool shutdown, size_t threadCount, std::vector<Timing> &timings)
+		{
+			std::unique_ptr<ThreadPool> pool;
+			if (threadCount != 1)
+				pool.reset(new ThreadPool(threadCount));
+
+			Run run(entries, shutdown, pool.get());
+			std::vector<size_t> roots;
+			for (size_t i = 0; i < run.Entries.size(); i++)
+				if (run.Entries[i]->Remaining == 0)
+					roots.push_back(i);
+
+			for (size_t root : roots)
+				schedule(run, root);
+
+			run.Done.Wait();
+			pool.reset();
+
+			bool success = true;
+			timings.clear();
+			for (auto *entry : run.Entries)
+			{
+				timings.push_back(entry->Result);
+				success = success && !entry->Failed;
+			}
+
+			return success;
+		}
+
+		// Takes the entries to run and links them, with mMutex held
+		bool prepare(bool shutdown, std::vector<Entry *> &entries)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mStarted == shutdown)
+			{
+				for (auto &entry : mEntries)
+					entries.push_back(entry.get());
+
+				if (link(entries, shutdown))
+				{
+					mStarted = !shutdown;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		StaticInitializer() : mStarted(false) { }
+
+	public:
+		static StaticInitializer &GetInstance()
+		{
+			static StaticInitializer instance;
+			return instance;
+		}
+
+		StaticInitializer(const StaticInitializer &) = delete;
+		StaticInitializer &operator=(const StaticInitializer &) = delete;
+
+		// Functions registered during or after Startup run right away on the calling
+		// thread, their dependencies are assumed to be up already
+		void Register(std::string name, std::vector<std::string> dependencies, std::function<void()> startup, std::function<void()> shutdown = std::function<void()>())
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+
+			auto entry = std::unique_ptr<Entry>(new Entry());
+			entry->Name = std::move(name);
+			entry->Dependencies = std::move(dependencies);
+			entry->Startup = std::move(startup);
+			entry->Shutdown = std::move(shutdown);
+			entry->Failed = false;
+			entry->Started = mStarted;
+
+			Entry &added = *entry;
+			mEntries.push_back(std::move(entry));
+
+			if (mStarted)
+			{
+				lock.unlock();
+				if (added.Startup)
+					added.Startup();
+			}
+		}
+
+		// Constructs Singleton<_TClass>'s instance during Startup, after the named
+		// dependencies and possibly in parallel with unrelated singletons. Instances
+		// are destroyed at exit in reverse order of construction, so dependents still
+		// go before their dependencies.
+		// Example:
+		//    static bool sRegistered = (StaticInitializer::GetInstance().RegisterSingleton<Config>("Config", {"Logger"}), true);
+		template <typename _TClass>
+		void RegisterSingleton(std::string name, std::vector<std::string> dependencies = std::vector<std::string>())
+		{
+			Register(std::move(name), std::move(dependencies), []() { Singleton<_TClass>::GetInstance(); });
+		}
+
+		// Runs every startup function. A thread count of 0 uses one thread per hardware
+		// thread and 1 runs everything on the calling thread. Returns false if a
+		// dependency is unknown, the dependencies form a cycle or a function threw;
+		// functions depending on one that threw are skipped.
+		bool Startup(size_t threadCount = 0)
+		{
+			std::lock_guard<std::mutex> running(mRunMutex);
+			std::vector<Entry *> entries;
+			if (!prepare(false, entries))
+				return false;
+
+			std::vector<Timing> timings;
+			const bool success = run(entries, false, threadCount, timings);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStartupTimings.swap(timings);
+			return success;
+		}
+
+		// Runs every shutdown function, each one before those of its dependencies.
+		// Nothing is shut down automatically: threads should not be started while
+		// the process exits, so call this before leaving main.
+		bool Shutdown(size_t threadCount = 0)
+		{
+			std::lock_guard<std::mutex> running(mRunMutex);
+			std::vector<Entry *> entries;
+			if (!prepare(true, entries))
+				return false;
+
+			std::vector<Timing> timings;
+			const bool success = run(entries, true, threadCount, timings);
+
+			std::lock_guard<std::mutex> lock(mMutex);
+			mShutdownTimings.swap(timings);
+			return success;
+		}
+
+		// Time spent in every function during the last Startup, in registration order
+		std::vector<Timing> GetStartupTimings()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mStartupTimings;
+		}
+
+		std::vector<Timing> GetShutdownTimings()
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			return mShutdownTimings;
+		}
+	};
+}
+
+#endif // indigo_static_initializer_hpp_
@@ -9,11 +9,20 @@
 #ifndef indigo_string_hpp_
 #define indigo_string_hpp_
 
+#include "StringSearch.hpp"
+#include "StringMatcher.hpp"
+#include "Format.hpp"
+#include "Unicode.hpp"
+#include <string>
+#include <string_view>
+#include <iterator>
 #include <utility>
 #include <vector>
+#include <charconv>
+#include <type_traits>
+#include <limits>
+#include <stdint.h>
 #include <stdarg.h>
-#include <codecvt>
-#include <locale>
 
 #ifndef INDIGO_CORE_STRING_BUFFERSIZE
 #define INDIGO_CORE_STRING_BUFFERSIZE 1024
@@ -24,53 +33,258 @@ namespace indigo
 	class String
 	{
 	public:
-		static bool Equals(std::string str1, std::string str2, bool caseInsensitive = false)
+		// Lazily splits a string on a separator, yielding views into the source
+		// without allocating. Yields the same pieces as Split.
+		// Example:
+		//    for (std::string_view line : String::SplitView(buffer, "\n"))
+		//        ...
+		class SplitRange
+		{
+			std::string_view mSource;
+			std::string_view mSeparator;
+
+		public:
+			class Iterator
+			{
+				std::string_view mRemaining;
+				std::string_view mSeparator;
+				std::string_view mCurrent;
+				// mCurrent is the final piece
+				bool mLast;
+				bool mEnd;
+
+				void advance()
+				{
+					if (mLast)
+					{
+						mEnd = true;
+						return;
+					}
+
+					const size_t position = mSeparator.empty() ? std::string_view::npos : mRemaining.find(mSeparator);
+					if (position == std::string_view::npos)
+					{
+						mCurrent = mRemaining;
+						mLast = true;
+					}
+					else
+					{
+						mCurrent = mRemaining.substr(0, position);
+						mRemaining.remove_prefix(position + mSeparator.size());
+					}
+				}
+
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef std::string_view value_type;
+				typedef ptrdiff_t difference_type;
+				typedef const std::string_view *pointer;
+				typedef const std::string_view &reference;
+
+				// End iterator
+				Iterator() : mLast(true), mEnd(true) { }
+
+				Iterator(std::string_view source, std::string_view separator)
+					: mRemaining(source), mSeparator(separator), mLast(false), mEnd(false)
+				{
+					advance();
+				}
+
+				reference operator*() const
+				{
+					return mCurrent;
+				}
+
+				pointer operator->() const
+				{
+					return &mCurrent;
+				}
+
+				Iterator &operator++()
+				{
+					advance();
+					return *this;
+				}
+
+				Iterator operator++(int)
+				{
+					Iterator previous = *this;
+					advance();
+					return previous;
+				}
+
+				bool operator==(const Iterator &other) const
+				{
+					if (mEnd || other.mEnd)
+						return mEnd == other.mEnd;
+
+					return mCurrent.data() == other.mCurrent.data() && mLast == other.mLast;
+				}
+
+				bool operator!=(const Iterator &other) const
+				{
+					return !(*this == other);
+				}
+			};
+
+			SplitRange(std::string_view source, std::string_view separator)
+				: mSource(source), mSeparator(separator) { }
+
+			Iterator begin() const
+			{
+				return Iterator(mSource, mSeparator);
+			}
+
+			Iterator end() const
+			{
+				return Iterator();
+			}
+		};
+
+		static bool Equals(std::string_view str1, std::string_view str2, bool caseInsensitive = false)
 		{
 			if (str1.size() != str2.size())
 				return false;
 
-			size_t size = str1.size() > str2.size() ? str2.size() : str1.size();
-			for (size_t i = 0; i < size; i++)
-				if (caseInsensitive && tolower(str1[i]) != tolower(str2[i]) || !caseInsensitive && str1[i] != str2[i])
-					return false;
+			if (!caseInsensitive)
+				return str1 == str2;
 
-			return true;
+			// Only ASCII letters are folded
+			return StringSearch::EqualsIgnoreCase(str1.data(), str2.data(), str1.size());
 		}
 
-		static bool Contains(const std::string &target, const std::string &contains)
+		static bool Contains(std::string_view target, std::string_view contains, bool caseInsensitive = false)
 		{
-			return strstr(target.c_str(), contains.c_str()) != nullptr;
+			return Find(target, contains, 0, caseInsensitive) != std::string_view::npos;
 		}
 
-		static bool IsNumber(const std::string &string)
+		// Position of the first occurrence of pattern at or after start, or npos.
+		// To search for the same pattern many times, use StringSearch::Searcher.
+		static size_t Find(std::string_view target, std::string_view pattern, size_t start = 0, bool caseInsensitive = false)
 		{
-			return string.find_first_not_of("0123456789") == std::string::npos;
+			if (!caseInsensitive)
+				return target.find(pattern, start);
+
+			return StringSearch::Searcher(pattern, true).Find(target, start);
+		}
+
+		static bool IsNumber(std::string_view string)
+		{
+			return string.find_first_not_of("0123456789") == std::string_view::npos;
 		}
 
-		static std::string Format(std::string format, ...)
+		// Parses the whole string, ignoring surrounding spaces and tabs, without
+		// throwing, allocating or depending on the locale. Integers take an optional
+		// sign and, like strtoll with base 0, a 0x prefix for hex or a leading 0 for
+		// octal. Returns false, leaving value alone, if the string is not a number
+		// of that type or does not fit in it.
+		// Example:
+		//    int64_t value;
+		//    if (String::ToNumber("0x7F", value))
+		//        ...
+		template <typename _TValue>
+		static bool ToNumber(std::string_view string, _TValue &value)
 		{
-			va_list arguments;
-			va_start(arguments, format);
+			static_assert(std::is_arithmetic_v<_TValue> && !std::is_same_v<_TValue, bool>, "Only numbers can be parsed");
+
+			while (!string.empty() && (string.front() == ' ' || string.front() == '\t'))
+				string.remove_prefix(1);
+			while (!string.empty() && (string.back() == ' ' || string.back() == '\t'))
+				string.remove_suffix(1);
+
+			bool negative = false;
+			if (!string.empty() && (string.front() == '+' || string.front() == '-'))
+			{
+				negative = string.front() == '-';
+				string.remove_prefix(1);
+			}
+
+			// A sign has to be followed by the number itself
+			if (string.empty() || string.front() == '+' || string.front() == '-')
+				return false;
+
+			if constexpr (std::is_floating_point_v<_TValue>)
+			{
+				_TValue result;
+				const auto parsed = std::from_chars(string.data(), string.data() + string.size(), result);
+				if (parsed.ec != std::errc() || parsed.ptr != string.data() + string.size())
+					return false;
+
+				value = negative ? -result : result;
+				return true;
+			}
+			else
+			{
+				int base = 10;
+				if (string.size() > 2 && string[0] == '0' && (string[1] == 'x' || string[1] == 'X'))
+				{
+					base = 16;
+					string.remove_prefix(2);
+				}
+				else if (string.size() > 1 && string[0] == '0')
+				{
+					base = 8;
+					string.remove_prefix(1);
+				}
 
-			const int length = _vscprintf(format.c_str(), arguments) + 1;
+				uint64_t magnitude;
+				const auto parsed = std::from_chars(string.data(), string.data() + string.size(), magnitude, base);
+				if (parsed.ec != std::errc() || parsed.ptr != string.data() + string.size())
+					return false;
 
-			std::string result;
-			result.resize(length);
+				if constexpr (std::is_signed_v<_TValue>)
+				{
+					const uint64_t limit = static_cast<uint64_t>((std::numeric_limits<_TValue>::max)()) + (negative ? 1 : 0);
+					if (magnitude > limit)
+						return false;
+
+					value = negative ? static_cast<_TValue>(0 - magnitude) : static_cast<_TValue>(magnitude);
+				}
+				else
+				{
+					if ((negative && magnitude != 0) || magnitude > (std::numeric_limits<_TValue>::max)())
+						return false;
+
+					value = static_cast<_TValue>(magnitude);
+				}
+
+				return true;
+			}
+		}
 
-			vsprintf_s(const_cast<char *>(result.c_str()), length, format.c_str(), arguments);
+		// Appends a number in decimal; floating point values use the shortest form
+		// that parses back to the same value
+		template <typename _TValue>
+		static void AppendNumber(std::string &output, _TValue value)
+		{
+			static_assert(std::is_arithmetic_v<_TValue> && !std::is_same_v<_TValue, bool>, "Only numbers can be formatted");
 
-			va_end(arguments);
+			char buffer[64];
+			const auto result = std::to_chars(buffer, buffer + sizeof buffer, value);
+			output.append(buffer, result.ptr - buffer);
+		}
 
-			// Remove null terminator
-			result.resize(length - 1);
+		template <typename _TValue>
+		static std::string FromNumber(_TValue value)
+		{
+			std::string output;
+			AppendNumber(output, value);
+			return output;
+		}
 
-			return result;
+		// Type-safe printf style formatting, see Formatter
+		// Example:
+		//    String::Format("%s: %s", header.first, header.second);
+		template <typename... _TArgs>
+		static std::string Format(FormatString<std::decay_t<_TArgs>...> format, const _TArgs &... arguments)
+		{
+			return Formatter::Format<_TArgs...>(format, arguments...);
 		}
 
-		static std::string PadLeft(const std::string &target, char character, size_t count)
+		static std::string PadLeft(std::string_view target, char character, size_t count)
 		{
 			if (count < target.size())
-				return target;
+				return std::string(target);
 
 			std::string output;
 
@@ -81,12 +295,12 @@ namespace indigo
 			return output;
 		}
 
-		static std::string PadRight(const std::string &target, char character, size_t count)
+		static std::string PadRight(std::string_view target, char character, size_t count)
 		{
 			if (count < target.size())
-				return target;
+				return std::string(target);
 
-			std::string output = target;
+			std::string output(target);
 
 			const size_t lengthToAdd = count - target.size();
 			output.append(lengthToAdd, character);
@@ -94,65 +308,136 @@ namespace indigo
 			return output;
 		}
 
-		static std::string Replace(std::string source, std::string from, const std::string &to, bool ignoreCase = false)
+		// Replaces every occurrence of from, scanning left to right and never
+		// matching inside text that was already replaced. Case-insensitive matching
+		// only folds ASCII letters.
+		static std::string Replace(std::string_view source, std::string_view from, std::string_view to, bool ignoreCase = false)
 		{
-			std::string output = std::move(source);
+			if (from.empty())
+				return std::string(source);
 
-			for (size_t x = 0; x < output.size(); x++)
+			const StringSearch::Searcher searcher(from, ignoreCase);
+
+			size_t match = searcher.Find(source);
+			if (match == std::string_view::npos)
+				return std::string(source);
+
+			std::string output;
+			output.reserve(source.size());
+
+			size_t position = 0;
+			do
 			{
-				bool same = true;
-				for (size_t y = 0; y < from.size(); y++)
-				{
-					char s = output[x + y];
-					char f = from[y];
+				output.append(source.data() + position, match - position);
+				output.append(to);
+				position = match + from.size();
+				match = searcher.Find(source, position);
+			}
+			while (match != std::string_view::npos);
 
-					if (ignoreCase)
-					{
-						s = tolower(s);
-						f = tolower(f);
-					}
+			output.append(source.data() + position, source.size() - position);
+			return output;
+		}
+
+		// Applies a whole table of replacements in a single pass over the source. At
+		// every position the longest matching pattern wins, and replaced text is
+		// never matched again.
+		// Example:
+		//    String::ReplaceAll(html, {{"&", "&amp;"}, {"<", "&lt;"}, {">", "&gt;"}});
+		static std::string ReplaceAll(std::string_view source, const std::vector<std::pair<std::string_view, std::string_view>> &replacements, bool ignoreCase = false)
+		{
+			// Patterns grouped by their first byte, longest first
+			std::vector<size_t> candidates[256];
+			for (size_t i = 0; i < replacements.size(); i++)
+			{
+				const std::string_view pattern = replacements[i].first;
+				if (pattern.empty())
+					continue;
+
+				const char first = ignoreCase ? StringSearch::ToLower(pattern[0]) : pattern[0];
+				auto &bucket = candidates[static_cast<uint8_t>(first)];
+
+				auto position = bucket.begin();
+				while (position != bucket.end() && replacements[*position].first.size() >= pattern.size())
+					++position;
 
-					if (s != f)
+				bucket.insert(position, i);
+			}
+
+			std::string output;
+			size_t copied = 0;
+			for (size_t i = 0; i < source.size();)
+			{
+				const char first = ignoreCase ? StringSearch::ToLower(source[i]) : source[i];
+				const auto &bucket = candidates[static_cast<uint8_t>(first)];
+
+				const std::pair<std::string_view, std::string_view> *found = nullptr;
+				for (size_t index : bucket)
+				{
+					const std::string_view pattern = replacements[index].first;
+					if (pattern.size() > source.size() - i)
+						continue;
+
+					const bool same = ignoreCase
+						? StringSearch::EqualsIgnoreCase(source.data() + i, pattern.data(), pattern.size())
+						: memcmp(source.data() + i, pattern.data(), pattern.size()) == 0;
+					if (same)
 					{
-						same = false;
+						found = &replacements[index];
 						break;
 					}
 				}
 
-				if (same)
-					output.replace(x, from.size(), to);
+				if (found == nullptr)
+				{
+					i++;
+					continue;
+				}
+
+				if (output.empty())
+					output.reserve(source.size());
+
+				output.append(source.data() + copied, i - copied);
+				output.append(found->second);
+				i += found->first.size();
+				copied = i;
 			}
 
+			if (copied == 0)
+				return std::string(source);
+
+			output.append(source.data() + copied, source.size() - copied);
 			return output;
 		}
 
-		static std::vector<std::string> Split(std::string source, const std::string &split)
+		static std::vector<std::string> Split(std::string_view source, std::string_view split)
 		{
-			std::string input = std::move(source);
 			std::vector<std::string> output;
-
-			size_t i;
-			while ((i = input.find(split)) != std::string::npos)
-			{
-				output.push_back(input.substr(0, i));
-				input.erase(0, i + split.size());
-			}
-
-			output.push_back(input);
+			for (std::string_view piece : SplitView(source, split))
+				output.emplace_back(piece);
 
 			return output;
 		}
 
-		static std::wstring ToWideString(const std::string &string)
+		static SplitRange SplitView(std::string_view source, std::string_view split)
 		{
-			std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>, wchar_t> utf16conv;
-			return utf16conv.from_bytes(string);
+			return SplitRange(source, split);
 		}
 
-		static std::string ToString(const std::wstring &string)
+		// Invalid sequences are replaced with U+FFFD. To detect them, or to reuse the
+		// output buffer, use Unicode directly.
+		static std::wstring ToWideString(std::string_view string)
 		{
-			std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> utf8conv;
-			return utf8conv.to_bytes(string);
+			std::wstring output;
+			Unicode::FromUtf8(string, output, true);
+			return output;
+		}
+
+		static std::string ToString(std::wstring_view string)
+		{
+			std::string output;
+			Unicode::ToUtf8(string, output, true);
+			return output;
 		}
 	};
 }
@@ -0,0 +1,318 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_string_matcher_hpp_
+#define indigo_string_matcher_hpp_
+
+// Required libraries
+#include "StringSearch.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <type_traits>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Finds any number of patterns in a single pass over the text (Aho-Corasick).
+	// The patterns are compiled into a state machine that takes one table lookup per
+	// byte, so scanning costs the same for ten patterns as for a thousand. Bytes
+	// that appear in no pattern share one column of the table, which keeps it small.
+	// A Stream carries the state across chunks, so matches spanning two chunks are
+	// found as well.
+	// Example:
+	//    StringMatcher matcher({"error", "timeout", "refused"}, true);
+	//    matcher.Scan(line, [](const StringMatcher::Match &match) { ... });
+	//    ...
+	//    auto stream = matcher.CreateStream();
+	//    while (ReadChunk(chunk))
+	//        stream.Feed(chunk, callback);
+	class StringMatcher
+	{
+	public:
+		struct Match
+		{
+			// Index of the pattern, in the order they were added
+			size_t Pattern;
+			// Offset of the first byte of the match; counted from the start of the
+			// stream when streaming
+			size_t Position;
+			size_t Length;
+		};
+
+	private:
+		static constexpr uint32_t kNone = 0xFFFFFFFF;
+		// Set on transitions into states where a match ends
+		static constexpr uint32_t kOutputFlag = 0x80000000;
+
+		bool mIgnoreCase;
+		bool mCompiled;
+		std::vector<std::string> mPatterns;
+
+		uint16_t mClasses[256];
+		uint32_t mClassCount;
+
+		// Rows of mClassCount entries per state; entries are the offset of the next
+		// state's row, plus kOutputFlag
+		std::vector<uint32_t> mTransitions;
+		// Per state (by row offset / mClassCount): the first pattern ending there and
+		// the nearest suffix state where another one ends
+		std::vector<uint32_t> mPatternAt;
+		std::vector<uint32_t> mOutputLink;
+		// Patterns added more than once
+		std::vector<uint32_t> mNextSamePattern;
+
+		uint8_t getByte(char character) const
+		{
+			return static_cast<uint8_t>(mIgnoreCase ? StringSearch::ToLower(character) : character);
+		}
+
+		// Calls callback for every pattern ending in state; false if it asked to stop
+		template <typename _TCallback>
+		bool report(uint32_t state, size_t end, _TCallback &callback) const
+		{
+			for (uint32_t current = state / mClassCount; current != kNone; current = mOutputLink[current])
+			{
+				for (uint32_t pattern = mPatternAt[current]; pattern != kNone; pattern = mNextSamePattern[pattern])
+				{
+					const size_t length = mPatterns[pattern].size();
+					const Match match = {pattern, end + 1 - length, length};
+					if constexpr (std::is_void_v<decltype(callback(match))>)
+						callback(match);
+					else if (!callback(match))
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		// Runs the machine over text starting in state, with offset being the
+		// position of text in the whole input. Returns the final state, or kNone if
+		// the callback stopped the scan.
+		template <typename _TCallback>
+		uint32_t run(uint32_t state, std::string_view text, size_t offset, _TCallback &callback) const
+		{
+			const uint32_t *transitions = mTransitions.data();
+			for (size_t i = 0; i < text.size(); i++)
+			{
+				const uint32_t next = transitions[state + mClasses[static_cast<uint8_t>(text[i])]];
+				state = next & ~kOutputFlag;
+				if ((next & kOutputFlag) != 0 && !report(state, offset + i, callback))
+					return kNone;
+			}
+
+			return state;
+		}
+
+	public:
+		// Passes matches to a callback while feeding the text in chunks
+		class Stream
+		{
+			const StringMatcher *mMatcher;
+			uint32_t mState;
+			size_t mOffset;
+
+		public:
+			explicit Stream(const StringMatcher &matcher) : mMatcher(&matcher), mState(0), mOffset(0) { }
+
+			// The callback takes a const Match & and may return false to stop; the
+			// stream then has to be Reset before feeding it more. Like Scan, does
+			// nothing and returns false until the matcher is compiled.
+			template <typename _TCallback>
+			bool Feed(std::string_view chunk, _TCallback &&callback)
+			{
+				if (!mMatcher->mCompiled)
+					return false;
+
+				const uint32_t state = mMatcher->run(mState, chunk, mOffset, callback);
+				mOffset += chunk.size();
+				if (state == kNone)
+					return false;
+
+				mState = state;
+				return true;
+			}
+
+			void Reset()
+			{
+				mState = 0;
+				mOffset = 0;
+			}
+
+			// Bytes fed so far
+			size_t GetOffset() const
+			{
+				return mOffset;
+			}
+		};
+
+		explicit StringMatcher(bool ignoreCase = false)
+			: mIgnoreCase(ignoreCase), mCompiled(false), mClassCount(1)
+		{
+			for (auto &byteClass : mClasses)
+				byteClass = 0;
+		}
+
+		StringMatcher(const std::vector<std::string_view> &patterns, bool ignoreCase = false)
+			: StringMatcher(ignoreCase)
+		{
+			for (auto pattern : patterns)
+				Add(pattern);
+
+			Compile();
+		}
+
+		// Returns the index matches will report for the pattern, or npos once the
+		// matcher is compiled. Empty patterns never match.
+		size_t Add(std::string_view pattern)
+		{
+			if (mCompiled)
+				return std::string::npos;
+
+			mPatterns.emplace_back(pattern);
+			return mPatterns.size() - 1;
+		}
+
+		void Compile()
+		{
+			if (mCompiled)
+				return;
+
+			// Byte classes: 0 for bytes that appear in no pattern
+			mClassCount = 1;
+			for (auto &byteClass : mClasses)
+				byteClass = 0;
+
+			for (auto &pattern : mPatterns)
+				for (char character : pattern)
+				{
+					const uint8_t byte = getByte(character);
+					if (mClasses[byte] == 0)
+						mClasses[byte] = static_cast<uint16_t>(mClassCount++);
+				}
+
+			if (mIgnoreCase)
+				for (int character = 'A'; character <= 'Z'; character++)
+					mClasses[character] = mClasses[character - 'A' + 'a'];
+
+			// Trie of the patterns, with states numbered by row
+			std::vector<uint32_t> goTo(mClassCount, kNone);
+			mPatternAt.assign(1, kNone);
+			mNextSamePattern.assign(mPatterns.size(), kNone);
+
+			for (uint32_t i = 0; i < mPatterns.size(); i++)
+			{
+				if (mPatterns[i].empty())
+					continue;
+
+				uint32_t state = 0;
+				for (char character : mPatterns[i])
+				{
+					uint32_t &next = goTo[state * mClassCount + mClasses[getByte(character)]];
+					if (next == kNone)
+					{
+						next = static_cast<uint32_t>(mPatternAt.size());
+						mPatternAt.push_back(kNone);
+						goTo.resize(goTo.size() + mClassCount, kNone);
+					}
+
+					state = goTo[state * mClassCount + mClasses[getByte(character)]];
+				}
+
+				mNextSamePattern[i] = mPatternAt[state];
+				mPatternAt[state] = i;
+			}
+
+			// Breadth-first over the trie to fill in the failure transitions, so
+			// every state has an entry for every class
+			const uint32_t stateCount = static_cast<uint32_t>(mPatternAt.size());
+			std::vector<uint32_t> failure(stateCount, 0);
+			std::vector<bool> hasOutput(stateCount, false);
+			mOutputLink.assign(stateCount, kNone);
+
+			std::vector<uint32_t> queue;
+			queue.reserve(stateCount);
+			for (uint32_t byteClass = 0; byteClass < mClassCount; byteClass++)
+			{
+				uint32_t &next = goTo[byteClass];
+				if (next == kNone)
+					next = 0;
+				else
+					queue.push_back(next);
+			}
+
+			for (size_t head = 0; head < queue.size(); head++)
+			{
+				const uint32_t state = queue[head];
+				hasOutput[state] = mPatternAt[state] != kNone || mOutputLink[state] != kNone;
+
+				for (uint32_t byteClass = 0; byteClass < mClassCount; byteClass++)
+				{
+					uint32_t &next = goTo[state * mClassCount + byteClass];
+					const uint32_t fallback = goTo[failure[state] * mClassCount + byteClass];
+					if (next == kNone)
+					{
+						next = fallback;
+						continue;
+					}
+
+					failure[next] = fallback;
+					mOutputLink[next] = mPatternAt[fallback] != kNone ? fallback : mOutputLink[fallback];
+					queue.push_back(next);
+				}
+			}
+
+			mTransitions.resize(goTo.size());
+			for (size_t i = 0; i < goTo.size(); i++)
+				mTransitions[i] = goTo[i] * mClassCount | (hasOutput[goTo[i]] ? kOutputFlag : 0);
+
+			mCompiled = true;
+		}
+
+		// Calls callback(const Match &) for every match, including overlapping ones,
+		// ordered by where they end. The callback may return false to stop early.
+		// Returns false if it did.
+		template <typename _TCallback>
+		bool Scan(std::string_view text, _TCallback &&callback) const
+		{
+			return mCompiled && run(0, text, 0, callback) != kNone;
+		}
+
+		std::vector<Match> FindAll(std::string_view text) const
+		{
+			std::vector<Match> matches;
+			Scan(text, [&matches](const Match &match) { matches.push_back(match); });
+			return matches;
+		}
+
+		bool ContainsAny(std::string_view text) const
+		{
+			bool found = false;
+			Scan(text, [&found](const Match &) { found = true; return false; });
+			return found;
+		}
+
+		Stream CreateStream() const
+		{
+			return Stream(*this);
+		}
+
+		size_t GetPatternCount() const
+		{
+			return mPatterns.size();
+		}
+
+		const std::string &GetPattern(size_t index) const
+		{
+			return mPatterns[index];
+		}
+	};
+}
+
+#endif // indigo_string_matcher_hpp_
@@ -0,0 +1,350 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_string_search_hpp_
+#define indigo_string_search_hpp_
+
+// Required libraries
+#include "Cpu.hpp"
+#include <string_view>
+#include <cstring>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Substring search and ASCII case folding kernels behind String. The SSE2
+	// versions are used wherever the compiler targets SSE2, and the AVX2 versions
+	// are picked at runtime on CPUs that support them.
+	class StringSearch
+	{
+	public:
+		static char ToLower(char character)
+		{
+			return character >= 'A' && character <= 'Z' ? static_cast<char>(character + ('a' - 'A')) : character;
+		}
+
+		static char ToUpper(char character)
+		{
+			return character >= 'a' && character <= 'z' ? static_cast<char>(character - ('a' - 'A')) : character;
+		}
+
+		// Position of the first byte equal to character, or size if there is none
+		static size_t FindByte(const char *data, size_t size, char character)
+		{
+			const void *found = memchr(data, character, size);
+			return found == nullptr ? size : static_cast<const char *>(found) - data;
+		}
+
+		// Position of the first byte equal to character in either ASCII case, or size
+		// if there is none
+		static size_t FindByteIgnoreCase(const char *data, size_t size, char character)
+		{
+			const char lower = ToLower(character);
+			const char upper = ToUpper(character);
+			if (lower == upper)
+				return FindByte(data, size, character);
+
+			size_t i = 0;
+#if defined(INDIGO_X86)
+			if (size >= 32 && Cpu::HasFeature(Cpu::kFeature_Avx2))
+				return findByteIgnoreCaseAvx2(data, size, lower, upper);
+#endif
+#if defined(INDIGO_SSE2)
+			const __m128i lowerVector = _mm_set1_epi8(lower);
+			const __m128i upperVector = _mm_set1_epi8(upper);
+			for (; i + 16 <= size; i += 16)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+				const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+					_mm_or_si128(_mm_cmpeq_epi8(block, lowerVector), _mm_cmpeq_epi8(block, upperVector))));
+				if (mask != 0)
+					return i + Cpu::CountTrailingZeros(mask);
+			}
+#endif
+			return i + findByteIgnoreCaseScalar(data + i, size - i, lower, upper);
+		}
+
+		static bool EqualsIgnoreCase(const char *left, const char *right, size_t size)
+		{
+			size_t i = 0;
+#if defined(INDIGO_X86)
+			if (size >= 32 && Cpu::HasFeature(Cpu::kFeature_Avx2))
+				return equalsIgnoreCaseAvx2(left, right, size);
+#endif
+#if defined(INDIGO_SSE2)
+			for (; i + 16 <= size; i += 16)
+			{
+				const __m128i a = foldBlock(_mm_loadu_si128(reinterpret_cast<const __m128i *>(left + i)));
+				const __m128i b = foldBlock(_mm_loadu_si128(reinterpret_cast<const __m128i *>(right + i)));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+					return false;
+			}
+#endif
+			return equalsIgnoreCaseScalar(left + i, right + i, size - i);
+		}
+
+		// Preprocessed pattern for repeated searches. With SSE2 or AVX2 a block of
+		// positions is filtered at once by comparing the first and the last byte of
+		// the pattern, and only positions where both match are compared in full.
+		// Without them Boyer-Moore-Horspool is used, which skips ahead by up to the
+		// pattern length on a mismatch.
+		class Searcher
+		{
+			std::string_view mPattern;
+			bool mIgnoreCase;
+			char mFirst;
+			char mLast;
+			size_t mSkip[256];
+
+			// Compares size bytes of the pattern, starting at offset, with data
+			bool matches(const char *data, size_t offset, size_t size) const
+			{
+				const char *pattern = mPattern.data() + offset;
+				return mIgnoreCase ? EqualsIgnoreCase(data, pattern, size) : memcmp(data, pattern, size) == 0;
+			}
+
+			bool matchesAt(const char *data) const
+			{
+				return mPattern.size() < 3 || matches(data + 1, 1, mPattern.size() - 2);
+			}
+
+			char fold(char character) const
+			{
+				return mIgnoreCase ? ToLower(character) : character;
+			}
+
+#if defined(INDIGO_SSE2)
+			// Checks every position from position on in blocks of 16, leaving position
+			// at the first one that is left over when nothing was found
+			bool findBlocks(const char *data, size_t count, size_t &position) const
+			{
+				const __m128i first = _mm_set1_epi8(mFirst);
+				const __m128i last = _mm_set1_epi8(mLast);
+				for (; position + 16 <= count; position += 16)
+				{
+					__m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + position));
+					__m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + position + mPattern.size() - 1));
+					if (mIgnoreCase)
+					{
+						head = foldBlock(head);
+						tail = foldBlock(tail);
+					}
+
+					uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+					for (; mask != 0; mask &= mask - 1)
+					{
+						const size_t candidate = position + Cpu::CountTrailingZeros(mask);
+						if (matchesAt(data + candidate))
+						{
+							position = candidate;
+							return true;
+						}
+					}
+				}
+
+				return false;
+			}
+#endif
+
+#if defined(INDIGO_X86)
+			INDIGO_TARGET("avx2")
+			bool findBlocksAvx2(const char *data, size_t count, size_t &position) const
+			{
+				const __m256i first = _mm256_set1_epi8(mFirst);
+				const __m256i last = _mm256_set1_epi8(mLast);
+				for (; position + 32 <= count; position += 32)
+				{
+					__m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + position));
+					__m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + position + mPattern.size() - 1));
+					if (mIgnoreCase)
+					{
+						head = foldBlockAvx2(head);
+						tail = foldBlockAvx2(tail);
+					}
+
+					uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+					for (; mask != 0; mask &= mask - 1)
+					{
+						const size_t candidate = position + Cpu::CountTrailingZeros(mask);
+						if (matchesAt(data + candidate))
+						{
+							position = candidate;
+							return true;
+						}
+					}
+				}
+
+				return false;
+			}
+#endif
+
+			size_t findHorspool(std::string_view text, size_t start) const
+			{
+				const size_t size = mPattern.size();
+				const size_t last = size - 1;
+				while (start + size <= text.size())
+				{
+					const char character = fold(text[start + last]);
+					if (character == mLast && matches(text.data() + start, 0, last))
+						return start;
+
+					start += mSkip[static_cast<uint8_t>(character)];
+				}
+
+				return std::string_view::npos;
+			}
+
+		public:
+			// The pattern is not copied and has to outlive the searcher
+			explicit Searcher(std::string_view pattern, bool ignoreCase = false)
+				: mPattern(pattern), mIgnoreCase(ignoreCase), mFirst(0), mLast(0)
+			{
+				if (pattern.empty())
+					return;
+
+				mFirst = fold(pattern.front());
+				mLast = fold(pattern.back());
+
+#if !defined(INDIGO_SSE2)
+				for (size_t i = 0; i < 256; i++)
+					mSkip[i] = pattern.size();
+
+				for (size_t i = 0; i + 1 < pattern.size(); i++)
+					mSkip[static_cast<uint8_t>(fold(pattern[i]))] = pattern.size() - 1 - i;
+#endif
+			}
+
+			// Position of the first match at or after start, or npos
+			size_t Find(std::string_view text, size_t start = 0) const
+			{
+				const size_t size = mPattern.size();
+				if (start > text.size() || size > text.size() - start)
+					return std::string_view::npos;
+
+				if (size == 0)
+					return start;
+
+#if defined(INDIGO_SSE2)
+				// Number of positions a match could start at
+				const size_t count = text.size() - size + 1;
+				size_t position = start;
+#if defined(INDIGO_X86)
+				if (count - position >= 32 && Cpu::HasFeature(Cpu::kFeature_Avx2) && findBlocksAvx2(text.data(), count, position))
+					return position;
+#endif
+				if (findBlocks(text.data(), count, position))
+					return position;
+
+				for (; position < count; position++)
+					if (fold(text[position]) == mFirst && fold(text[position + size - 1]) == mLast && matchesAt(text.data() + position))
+						return position;
+
+				return std::string_view::npos;
+#else
+				return findHorspool(text, start);
+#endif
+			}
+
+			size_t GetSize() const
+			{
+				return mPattern.size();
+			}
+		};
+
+	private:
+		static size_t findByteIgnoreCaseScalar(const char *data, size_t size, char lower, char upper)
+		{
+			for (size_t i = 0; i < size; i++)
+				if (data[i] == lower || data[i] == upper)
+					return i;
+
+			return size;
+		}
+
+		static bool equalsIgnoreCaseScalar(const char *left, const char *right, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+				if (ToLower(left[i]) != ToLower(right[i]))
+					return false;
+
+			return true;
+		}
+
+#if defined(INDIGO_SSE2)
+		// Adds 0x20 to every byte in 'A'-'Z'
+		static __m128i foldBlock(__m128i block)
+		{
+			// Shift 'A' to -128 so one signed compare finds the 26 upper case letters
+			const __m128i shifted = _mm_add_epi8(block, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m128i isUpper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+			return _mm_add_epi8(block, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+		}
+#endif
+
+#if defined(INDIGO_X86)
+		INDIGO_TARGET("avx2")
+		static __m256i foldBlockAvx2(__m256i block)
+		{
+			const __m256i shifted = _mm256_add_epi8(block, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+			const __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 26)), shifted);
+			return _mm256_add_epi8(block, _mm256_and_si256(isUpper, _mm256_set1_epi8(0x20)));
+		}
+
+		INDIGO_TARGET("avx2")
+		static size_t findByteIgnoreCaseAvx2(const char *data, size_t size, char lower, char upper)
+		{
+			const __m256i lowerVector = _mm256_set1_epi8(lower);
+			const __m256i upperVector = _mm256_set1_epi8(upper);
+
+			size_t i = 0;
+			for (; i + 32 <= size; i += 32)
+			{
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+				const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+					_mm256_or_si256(_mm256_cmpeq_epi8(block, lowerVector), _mm256_cmpeq_epi8(block, upperVector))));
+				if (mask != 0)
+					return i + Cpu::CountTrailingZeros(mask);
+			}
+
+			// Finish with one overlapping block instead of a scalar tail
+			if (i < size)
+			{
+				const size_t last = size - 32;
+				const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + last));
+				const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+					_mm256_or_si256(_mm256_cmpeq_epi8(block, lowerVector), _mm256_cmpeq_epi8(block, upperVector))));
+				if (mask != 0)
+					return last + Cpu::CountTrailingZeros(mask);
+			}
+
+			return size;
+		}
+
+		INDIGO_TARGET("avx2")
+		static bool equalsIgnoreCaseAvx2(const char *left, const char *right, size_t size)
+		{
+			// Callers guarantee at least one full block, so the tail can overlap
+			for (size_t i = 0;; i += 32)
+			{
+				if (i + 32 > size)
+					i = size - 32;
+
+				const __m256i a = foldBlockAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + i)));
+				const __m256i b = foldBlockAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(right + i)));
+				if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFF)
+					return false;
+
+				if (i + 32 == size)
+					return true;
+			}
+		}
+#endif
+	};
+}
+
+#endif // indigo_string_search_hpp_
@@ -0,0 +1,38 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_thread_local_singleton_hpp_
+#define indigo_thread_local_singleton_hpp_
+
+namespace indigo
+{
+	// One instance per thread, created on the thread's first access and destroyed
+	// when the thread exits. Access needs no locking and never shares cache lines
+	// with other threads.
+	template <typename _TClass>
+	class ThreadLocalSingleton
+	{
+	public:
+		static _TClass &GetInstance()
+		{
+			thread_local _TClass instance;
+			return instance;
+		}
+
+		static _TClass *GetInstancePtr()
+		{
+			return &GetInstance();
+		}
+
+		ThreadLocalSingleton() { }
+		explicit ThreadLocalSingleton(_TClass const &) = delete;
+		void operator=(_TClass const &) = delete;
+	};
+}
+
+#endif // indigo_thread_local_singleton_hpp_
@@ -0,0 +1,116 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_thread_pool_hpp_
+#define indigo_thread_pool_hpp_
+
+// Required libraries
+#include "InlineFunction.hpp"
+#include "Semaphore.hpp"
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace indigo
+{
+	// Fixed set of worker threads running submitted tasks in submission order.
+	// Destroying the pool finishes the tasks that are already queued.
+	// Example:
+	//    ThreadPool pool;
+	//    Latch done(2);
+	//    pool.Submit([&]() { ...; done.CountDown(); });
+	//    pool.Submit([&]() { ...; done.CountDown(); });
+	//    done.Wait();
+	class ThreadPool
+	{
+		typedef InlineFunction<void()> Task;
+
+		std::mutex mMutex;
+		std::deque<Task> mTasks;
+		Semaphore mPending;
+		std::vector<std::thread> mThreads;
+		bool mStopping;
+
+		void run()
+		{
+			for (;;)
+			{
+				mPending.Acquire();
+
+				Task task;
+				{
+					std::lock_guard<std::mutex> lock(mMutex);
+					if (mTasks.empty())
+					{
+						if (mStopping)
+							return;
+
+						continue;
+					}
+
+					task = std::move(mTasks.front());
+					mTasks.pop_front();
+				}
+
+				task();
+			}
+		}
+
+	public:
+		// Defaults to one thread per hardware thread
+		explicit ThreadPool(size_t threadCount = 0)
+			: mStopping(false)
+		{
+			if (threadCount == 0)
+				threadCount = GetHardwareThreads();
+
+			for (size_t i = 0; i < threadCount; i++)
+				mThreads.emplace_back(&ThreadPool::run, this);
+		}
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStopping = true;
+			}
+
+			mPending.Release(static_cast<uint32_t>(mThreads.size()));
+			for (auto &thread : mThreads)
+				thread.join();
+		}
+
+		template <typename _TFunction>
+		void Submit(_TFunction &&function)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mTasks.emplace_back(std::forward<_TFunction>(function));
+			}
+
+			mPending.Release();
+		}
+
+		size_t GetThreadCount() const
+		{
+			return mThreads.size();
+		}
+
+		static size_t GetHardwareThreads()
+		{
+			const unsigned int count = std::thread::hardware_concurrency();
+			return count == 0 ? 1 : count;
+		}
+	};
+}
+
+#endif // indigo_thread_pool_hpp_
@@ -0,0 +1,389 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_unicode_hpp_
+#define indigo_unicode_hpp_
+
+// Required libraries
+#include "Cpu.hpp"
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Validating conversion between UTF-8 and UTF-16/UTF-32. Runs of ASCII are
+	// checked and widened or narrowed 16 characters at a time. The output strings
+	// are overwritten, not appended to, so a caller converting many strings can keep
+	// reusing the same ones without allocating.
+	// Invalid input (overlong forms, surrogates in UTF-8, unpaired surrogates in
+	// UTF-16, code points past U+10FFFF, truncated sequences) makes a conversion
+	// return false. Without replaceInvalid it stops there, leaving what was
+	// converted so far in the output; with it every invalid sequence becomes
+	// U+FFFD and the conversion carries on.
+	// Example:
+	//    std::wstring wide;
+	//    for (auto &name : names)
+	//        if (Unicode::FromUtf8(name, wide))
+	//            ...
+	class Unicode
+	{
+		static const uint32_t kInvalid = 0xFFFFFFFF;
+		static const uint32_t kReplacement = 0xFFFD;
+
+		// Widens the leading ASCII characters of input and returns how many there were
+		template <typename _TChar>
+		static size_t widenAscii(const uint8_t *input, size_t size, _TChar *output)
+		{
+			size_t i = 0;
+#if defined(INDIGO_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= size; i += 16)
+			{
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+				if (_mm_movemask_epi8(block) != 0)
+					break;
+
+				const __m128i low = _mm_unpacklo_epi8(block, zero);
+				const __m128i high = _mm_unpackhi_epi8(block, zero);
+				if (sizeof(_TChar) == 2)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), low);
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i + 8), high);
+				}
+				else
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_unpacklo_epi16(low, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i + 4), _mm_unpackhi_epi16(low, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i + 8), _mm_unpacklo_epi16(high, zero));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i + 12), _mm_unpackhi_epi16(high, zero));
+				}
+			}
+#endif
+			for (; i < size && input[i] < 0x80; i++)
+				output[i] = static_cast<_TChar>(input[i]);
+
+			return i;
+		}
+
+		// Narrows the leading ASCII characters of input and returns how many there were
+		template <typename _TChar>
+		static size_t narrowAscii(const _TChar *input, size_t size, uint8_t *output)
+		{
+			size_t i = 0;
+#if defined(INDIGO_SSE2)
+			if (sizeof(_TChar) == 2)
+			{
+				const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+				for (; i + 16 <= size; i += 16)
+				{
+					const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+					const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 8));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(low, high), mask), _mm_setzero_si128())) != 0xFFFF)
+						break;
+
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_packus_epi16(low, high));
+				}
+			}
+			else
+			{
+				const __m128i mask = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+				for (; i + 16 <= size; i += 16)
+				{
+					const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+					const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 4));
+					const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 8));
+					const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + 12));
+					const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+					if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, mask), _mm_setzero_si128())) != 0xFFFF)
+						break;
+
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+				}
+			}
+#endif
+			for (; i < size && static_cast<uint32_t>(input[i]) < 0x80; i++)
+				output[i] = static_cast<uint8_t>(input[i]);
+
+			return i;
+		}
+
+		// Decodes one sequence and returns its length. A malformed sequence gives
+		// kInvalid and the length of its longest valid prefix, at least 1.
+		static size_t decodeUtf8(const uint8_t *input, const uint8_t *end, uint32_t &codePoint)
+		{
+			const uint8_t lead = input[0];
+			if (lead < 0x80)
+			{
+				codePoint = lead;
+				return 1;
+			}
+
+			// Well-formed two and three byte sequences (most non-Latin text) are
+			// checked in one go
+			const size_t available = end - input;
+			if (lead >= 0xC2 && lead <= 0xDF && available >= 2 && (input[1] & 0xC0) == 0x80)
+			{
+				codePoint = ((lead & 0x1F) << 6) | (input[1] & 0x3F);
+				return 2;
+			}
+
+			if ((lead & 0xF0) == 0xE0 && available >= 3 && ((input[1] & 0xC0) | ((input[2] & 0xC0) >> 2)) == 0xA0)
+			{
+				codePoint = ((lead & 0x0F) << 12) | ((input[1] & 0x3F) << 6) | (input[2] & 0x3F);
+				if (codePoint >= 0x800 && (codePoint < 0xD800 || codePoint > 0xDFFF))
+					return 3;
+			}
+
+			size_t length;
+			uint32_t value;
+			// Valid range of the second byte, which rules out overlong forms,
+			// surrogates and code points past U+10FFFF
+			uint8_t low = 0x80, high = 0xBF;
+			if (lead >= 0xC2 && lead <= 0xDF)
+			{
+				length = 2;
+				value = lead & 0x1F;
+			}
+			else if (lead >= 0xE0 && lead <= 0xEF)
+			{
+				length = 3;
+				value = lead & 0x0F;
+				if (lead == 0xE0)
+					low = 0xA0;
+				else if (lead == 0xED)
+					high = 0x9F;
+			}
+			else if (lead >= 0xF0 && lead <= 0xF4)
+			{
+				length = 4;
+				value = lead & 0x07;
+				if (lead == 0xF0)
+					low = 0x90;
+				else if (lead == 0xF4)
+					high = 0x8F;
+			}
+			else
+			{
+				codePoint = kInvalid;
+				return 1;
+			}
+
+			for (size_t i = 1; i < length; i++)
+			{
+				if (input + i >= end || input[i] < low || input[i] > high)
+				{
+					codePoint = kInvalid;
+					return i;
+				}
+
+				value = (value << 6) | (input[i] & 0x3F);
+				low = 0x80;
+				high = 0xBF;
+			}
+
+			codePoint = value;
+			return length;
+		}
+
+		static size_t encodeUtf8(uint32_t codePoint, uint8_t *output)
+		{
+			if (codePoint < 0x80)
+			{
+				output[0] = static_cast<uint8_t>(codePoint);
+				return 1;
+			}
+
+			if (codePoint < 0x800)
+			{
+				output[0] = static_cast<uint8_t>(0xC0 | (codePoint >> 6));
+				output[1] = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+				return 2;
+			}
+
+			if (codePoint < 0x10000)
+			{
+				output[0] = static_cast<uint8_t>(0xE0 | (codePoint >> 12));
+				output[1] = static_cast<uint8_t>(0x80 | ((codePoint >> 6) & 0x3F));
+				output[2] = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+				return 3;
+			}
+
+			output[0] = static_cast<uint8_t>(0xF0 | (codePoint >> 18));
+			output[1] = static_cast<uint8_t>(0x80 | ((codePoint >> 12) & 0x3F));
+			output[2] = static_cast<uint8_t>(0x80 | ((codePoint >> 6) & 0x3F));
+			output[3] = static_cast<uint8_t>(0x80 | (codePoint & 0x3F));
+			return 4;
+		}
+
+		template <typename _TChar>
+		static bool toUtf8(const _TChar *input, size_t size, std::string &output, bool replaceInvalid)
+		{
+			static_assert(sizeof(_TChar) == 2 || sizeof(_TChar) == 4, "Only UTF-16 and UTF-32 are supported");
+
+			// A UTF-16 unit never takes more than 3 bytes, a surrogate pair takes 4
+			output.resize(size * (sizeof(_TChar) == 2 ? 3 : 4));
+			uint8_t *const begin = reinterpret_cast<uint8_t *>(&output[0]);
+			uint8_t *out = begin;
+
+			const _TChar *const end = input + size;
+			bool valid = true;
+			while (input < end)
+			{
+				if (static_cast<uint32_t>(input[0]) < 0x80)
+				{
+					const size_t ascii = narrowAscii(input, end - input, out);
+					input += ascii;
+					out += ascii;
+					continue;
+				}
+
+				uint32_t codePoint = static_cast<uint32_t>(input[0]);
+				size_t length = 1;
+				if (sizeof(_TChar) == 2)
+				{
+					codePoint &= 0xFFFF;
+					if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+					{
+						const uint32_t next = input + 1 < end ? static_cast<uint32_t>(input[1]) & 0xFFFF : 0;
+						if (codePoint <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF)
+						{
+							codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (next - 0xDC00);
+							length = 2;
+						}
+						else
+						{
+							codePoint = kInvalid;
+						}
+					}
+				}
+				else if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+				{
+					codePoint = kInvalid;
+				}
+
+				if (codePoint == kInvalid)
+				{
+					valid = false;
+					if (!replaceInvalid)
+						break;
+
+					codePoint = kReplacement;
+				}
+
+				out += encodeUtf8(codePoint, out);
+				input += length;
+			}
+
+			output.resize(out - begin);
+			return valid;
+		}
+
+	public:
+		// Converts to UTF-16 when _TChar is 2 bytes (char16_t, wchar_t on Windows)
+		// and to UTF-32 when it is 4 bytes (char32_t, wchar_t elsewhere)
+		template <typename _TChar>
+		static bool FromUtf8(std::string_view input, std::basic_string<_TChar> &output, bool replaceInvalid = false)
+		{
+			static_assert(sizeof(_TChar) == 2 || sizeof(_TChar) == 4, "Only UTF-16 and UTF-32 are supported");
+
+			// Never more units than bytes
+			output.resize(input.size());
+			_TChar *const begin = &output[0];
+			_TChar *out = begin;
+
+			const uint8_t *in = reinterpret_cast<const uint8_t *>(input.data());
+			const uint8_t *const end = in + input.size();
+			bool valid = true;
+			while (in < end)
+			{
+				if (*in < 0x80)
+				{
+					const size_t ascii = widenAscii(in, end - in, out);
+					in += ascii;
+					out += ascii;
+					continue;
+				}
+
+				uint32_t codePoint;
+				const size_t length = decodeUtf8(in, end, codePoint);
+				if (codePoint == kInvalid)
+				{
+					valid = false;
+					if (!replaceInvalid)
+						break;
+
+					codePoint = kReplacement;
+				}
+
+				if (sizeof(_TChar) == 2 && codePoint >= 0x10000)
+				{
+					codePoint -= 0x10000;
+					*out++ = static_cast<_TChar>(0xD800 + (codePoint >> 10));
+					*out++ = static_cast<_TChar>(0xDC00 + (codePoint & 0x3FF));
+				}
+				else
+				{
+					*out++ = static_cast<_TChar>(codePoint);
+				}
+
+				in += length;
+			}
+
+			output.resize(out - begin);
+			return valid;
+		}
+
+		static bool ToUtf8(std::u16string_view input, std::string &output, bool replaceInvalid = false)
+		{
+			return toUtf8(input.data(), input.size(), output, replaceInvalid);
+		}
+
+		static bool ToUtf8(std::u32string_view input, std::string &output, bool replaceInvalid = false)
+		{
+			return toUtf8(input.data(), input.size(), output, replaceInvalid);
+		}
+
+		static bool ToUtf8(std::wstring_view input, std::string &output, bool replaceInvalid = false)
+		{
+			return toUtf8(input.data(), input.size(), output, replaceInvalid);
+		}
+
+		static bool IsValidUtf8(std::string_view input)
+		{
+			const uint8_t *in = reinterpret_cast<const uint8_t *>(input.data());
+			const uint8_t *const end = in + input.size();
+			while (in < end)
+			{
+				size_t i = 0;
+				const size_t size = end - in;
+#if defined(INDIGO_SSE2)
+				for (; i + 16 <= size; i += 16)
+					if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))) != 0)
+						break;
+#endif
+				while (i < size && in[i] < 0x80)
+					i++;
+
+				in += i;
+				if (in == end)
+					break;
+
+				uint32_t codePoint;
+				in += decodeUtf8(in, end, codePoint);
+				if (codePoint == kInvalid)
+					return false;
+			}
+
+			return true;
+		}
+	};
+}
+
+#endif // indigo_unicode_hpp_
@@ -0,0 +1,260 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_wait_handle_hpp_
+#define indigo_wait_handle_hpp_
+
+#include "Futex.hpp"
+#include <vector>
+#include <initializer_list>
+
+namespace indigo
+{
+	// Base of the futex-backed events (ManualReset and AutoReset). The whole state
+	// lives in one 32-bit word, so setting an event nobody waits on is a single
+	// atomic exchange, and waiters spin for a while before they park in the kernel.
+	class WaitHandle
+	{
+	protected:
+		enum State : uint32_t
+		{
+			kState_Unsignaled = 0,
+			kState_Signaled = 1,
+			// Unsignaled, and somebody is parked on the word
+			kState_Waiting = 2
+		};
+
+		static const uint32_t kMinSpin = 16;
+		static const uint32_t kMaxSpin = 4096;
+
+		std::atomic<uint32_t> mState;
+
+		// Adapts to how long the event usually takes to become signaled: grows while
+		// spinning pays off and shrinks whenever a waiter had to park anyway
+		std::atomic<uint32_t> mSpin;
+
+		// Waiters in WaitAny/WaitAll park on a shared generation word, which Set bumps
+		// only while such waiters exist
+		static std::atomic<uint32_t> &getMultiWaiters()
+		{
+			static std::atomic<uint32_t> waiters(0);
+			return waiters;
+		}
+
+		static std::atomic<uint32_t> &getGeneration()
+		{
+			static std::atomic<uint32_t> generation(0);
+			return generation;
+		}
+
+		explicit WaitHandle(bool initialState)
+			: mState(initialState ? kState_Signaled : kState_Unsignaled), mSpin(128) { }
+
+		void signal(bool wakeAll)
+		{
+			if (mState.exchange(kState_Signaled, std::memory_order_seq_cst) == kState_Waiting)
+			{
+				if (wakeAll)
+					Futex::WakeAll(mState);
+				else
+					Futex::WakeOne(mState);
+			}
+
+			if (getMultiWaiters().load(std::memory_order_seq_cst) != 0)
+			{
+				getGeneration().fetch_add(1, std::memory_order_seq_cst);
+				Futex::WakeAll(getGeneration());
+			}
+		}
+
+		bool spin()
+		{
+			// On a single CPU the signaling thread cannot run while we spin
+			const uint32_t spin = Futex::GetSpinCount(mSpin.load(std::memory_order_relaxed));
+			if (spin == 0)
+				return false;
+
+			for (uint32_t i = 0; i < spin; i++)
+			{
+				if (mState.load(std::memory_order_relaxed) == kState_Signaled && TryWait())
+				{
+					mSpin.store(spin < kMaxSpin ? spin + spin / 8 + 1 : kMaxSpin, std::memory_order_relaxed);
+					return true;
+				}
+
+				Futex::Pause();
+			}
+
+			mSpin.store(spin > kMinSpin ? spin / 2 : kMinSpin, std::memory_order_relaxed);
+			return false;
+		}
+
+		bool wait(int timeout)
+		{
+			if (TryWait() || spin())
+				return true;
+
+			const FutexDeadline deadline(timeout);
+			bool parked = false;
+			for (;;)
+			{
+				uint32_t state = mState.load(std::memory_order_acquire);
+				if (state == kState_Signaled)
+				{
+					// Having parked, assume others are still parked behind us
+					if (consume(parked))
+						return true;
+
+					continue;
+				}
+
+				if (state == kState_Unsignaled && !mState.compare_exchange_weak(state, kState_Waiting, std::memory_order_acq_rel))
+					continue;
+
+				const int64_t remaining = deadline.GetRemaining();
+				if (remaining == 0)
+				{
+					if (TryWait())
+						return true;
+
+					// We may have been woken in place of a waiter that is still parked,
+					// so make sure the next Set wakes somebody
+					uint32_t unsignaled = kState_Unsignaled;
+					if (parked)
+						mState.compare_exchange_strong(unsignaled, kState_Waiting, std::memory_order_acq_rel);
+
+					return false;
+				}
+
+				Futex::Wait(mState, kState_Waiting, remaining);
+				parked = true;
+			}
+		}
+
+		// Takes the signal after it was observed, auto-reset events clear it here
+		virtual bool consume(bool othersWaiting) = 0;
+
+		// Undoes a successful TryWait
+		virtual void release() = 0;
+
+	public:
+		WaitHandle(const WaitHandle &) = delete;
+		WaitHandle &operator=(const WaitHandle &) = delete;
+
+		virtual ~WaitHandle() { }
+
+		bool IsSet() const
+		{
+			return mState.load(std::memory_order_acquire) == kState_Signaled;
+		}
+
+		// Takes the signal if the handle is signaled, without blocking
+		bool TryWait()
+		{
+			return IsSet() && consume(false);
+		}
+
+		// Waits until one of the handles is signaled and returns its index, or -1
+		// once the timeout (in milliseconds, 0 waits forever) expires. Only the
+		// returned handle is acquired.
+		static int WaitAny(const std::vector<WaitHandle *> &handles, int timeout = 0)
+		{
+			const FutexDeadline deadline(timeout);
+
+			const uint32_t spin = Futex::GetSpinCount(kMaxSpin);
+			for (uint32_t i = 0; i < spin; i++)
+			{
+				for (size_t j = 0; j < handles.size(); j++)
+					if (handles[j]->TryWait())
+						return static_cast<int>(j);
+
+				Futex::Pause();
+			}
+
+			getMultiWaiters().fetch_add(1, std::memory_order_seq_cst);
+
+			int result = -1;
+			for (;;)
+			{
+				const uint32_t generation = getGeneration().load(std::memory_order_seq_cst);
+				for (size_t j = 0; j < handles.size() && result < 0; j++)
+					if (handles[j]->TryWait())
+						result = static_cast<int>(j);
+
+				const int64_t remaining = deadline.GetRemaining();
+				if (result >= 0 || remaining == 0)
+					break;
+
+				Futex::Wait(getGeneration(), generation, remaining);
+			}
+
+			getMultiWaiters().fetch_sub(1, std::memory_order_seq_cst);
+			return result;
+		}
+
+		static int WaitAny(std::initializer_list<WaitHandle *> handles, int timeout = 0)
+		{
+			return WaitAny(std::vector<WaitHandle *>(handles), timeout);
+		}
+
+		// Waits until every handle is signaled and acquires them all together.
+		// Returns false once the timeout (in milliseconds, 0 waits forever) expires.
+		static bool WaitAll(const std::vector<WaitHandle *> &handles, int timeout = 0)
+		{
+			const FutexDeadline deadline(timeout);
+
+			getMultiWaiters().fetch_add(1, std::memory_order_seq_cst);
+
+			bool result = false;
+			for (;;)
+			{
+				const uint32_t generation = getGeneration().load(std::memory_order_seq_cst);
+
+				bool all = true;
+				for (auto *handle : handles)
+					all = all && handle->IsSet();
+
+				if (all)
+				{
+					// Acquire them one by one, and hand back what we took if
+					// another thread got to one of them first
+					size_t acquired = 0;
+					while (acquired < handles.size() && handles[acquired]->TryWait())
+						acquired++;
+
+					if (acquired == handles.size())
+					{
+						result = true;
+						break;
+					}
+
+					for (size_t i = 0; i < acquired; i++)
+						handles[i]->release();
+
+					continue;
+				}
+
+				const int64_t remaining = deadline.GetRemaining();
+				if (remaining == 0)
+					break;
+
+				Futex::Wait(getGeneration(), generation, remaining);
+			}
+
+			getMultiWaiters().fetch_sub(1, std::memory_order_seq_cst);
+			return result;
+		}
+
+		static bool WaitAll(std::initializer_list<WaitHandle *> handles, int timeout = 0)
+		{
+			return WaitAll(std::vector<WaitHandle *>(handles), timeout);
+		}
+	};
+}
+
+#endif // indigo_wait_handle_hpp_
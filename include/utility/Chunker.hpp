@@ -0,0 +1,265 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_chunker_hpp_
+#define indigo_chunker_hpp_
+
+// Required libraries
+#include "../core/Buffer.hpp"
+#include "MappedFile.hpp"
+#include "Sha256.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Gear rolling hash: every byte shifts the hash left by one and adds a
+	// random value for the byte, so the top bits depend on about the last 64
+	// bytes and nothing else. The table is generated at compile time from a fixed
+	// seed, so hashes are the same everywhere.
+	class GearHash
+	{
+		struct Table
+		{
+			uint64_t Values[256];
+
+			// SplitMix64
+			constexpr Table() : Values()
+			{
+				uint64_t state = 0x2545F4914F6CDD1D;
+				for (size_t i = 0; i < 256; i++)
+				{
+					state += 0x9E3779B97F4A7C15;
+					uint64_t value = state;
+					value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+					value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+					Values[i] = value ^ (value >> 31);
+				}
+			}
+		};
+
+		static const Table kTable;
+
+	public:
+		static uint64_t Roll(uint64_t hash, uint8_t byte)
+		{
+			return (hash << 1) + kTable.Values[byte];
+		}
+	};
+
+	inline constexpr GearHash::Table GearHash::kTable = GearHash::Table();
+
+	// Content-defined chunking (FastCDC). Boundaries are placed where the rolling
+	// hash of the last bytes matches a mask, so they follow the content: an insert
+	// near the start of a file only changes the chunks around it, and the rest
+	// still deduplicate against the old version. Cuts before the average size use
+	// a stricter mask and cuts after it a looser one, which keeps chunk sizes close
+	// to the average. Each chunk is also hashed with _THasher, SHA-256 by default;
+	// any hasher from Hash works, such as Hash::XXH3_64Hasher when the chunks only
+	// need to be told apart locally.
+	// Example:
+	//    Chunker<> chunker(16 * 1024, 64 * 1024, 256 * 1024);
+	//    chunker.SplitFile(path, [&](const Chunker<>::Chunk &chunk)
+	//    {
+	//        if (!store.Contains(chunk.Hash))
+	//            Upload(path, chunk.Offset, chunk.Size);
+	//    });
+	template <typename _THasher = Sha256>
+	class Chunker
+	{
+	public:
+		struct Chunk
+		{
+			uint64_t Offset;
+			size_t Size;
+			typename _THasher::Result Hash;
+		};
+
+		static constexpr size_t kDefaultMinimumSize = 16 * 1024;
+		static constexpr size_t kDefaultAverageSize = 64 * 1024;
+		static constexpr size_t kDefaultMaximumSize = 256 * 1024;
+
+	private:
+		static constexpr size_t kReadSize = 1024 * 1024;
+
+		size_t mMinimumSize;
+		size_t mAverageSize;
+		size_t mMaximumSize;
+		uint64_t mStrictMask;
+		uint64_t mLooseMask;
+		_THasher mHasher;
+
+		// The top bits of the hash, since only those see the whole window
+		static uint64_t getMask(uint32_t bits)
+		{
+			return bits == 0 ? 0 : ~0ull << (64 - bits);
+		}
+
+		template <typename _TCallback>
+		void emit(const uint8_t *data, size_t size, uint64_t offset, _TCallback &callback) const
+		{
+			_THasher hasher = mHasher;
+			hasher.Update(data, size);
+			const Chunk chunk = { offset, size, hasher.Finalize() };
+			callback(chunk);
+		}
+
+	public:
+		// The sizes are clamped so that 64 <= minimum <= average <= maximum
+		Chunker(size_t minimumSize = kDefaultMinimumSize, size_t averageSize = kDefaultAverageSize, size_t maximumSize = kDefaultMaximumSize,
+		        const _THasher &hasher = _THasher())
+			: mHasher(hasher)
+		{
+			mMinimumSize = minimumSize < 64 ? 64 : minimumSize;
+			mAverageSize = averageSize < mMinimumSize ? mMinimumSize : averageSize;
+			mMaximumSize = maximumSize < mAverageSize ? mAverageSize : maximumSize;
+
+			// A mask of n bits matches once every 2^n bytes. The cuts start at the
+			// minimum, so aim for the distance left to the average.
+			uint32_t bits = 0;
+			while (bits < 62 && (2ull << bits) <= mAverageSize - mMinimumSize)
+				bits++;
+
+			mStrictMask = getMask(bits + 2);
+			mLooseMask = getMask(bits > 2 ? bits - 2 : 0);
+		}
+
+		// Length of the chunk at the start of data. A chunk can only end before
+		// size if at least the maximum size is given, or if data ends the input.
+		size_t FindBoundary(const void *data, size_t size) const
+		{
+			const uint8_t *bytes = static_cast<const uint8_t *>(data);
+			if (size <= mMinimumSize)
+				return size;
+
+			const size_t limit = size < mMaximumSize ? size : mMaximumSize;
+			const size_t normal = limit < mAverageSize ? limit : mAverageSize;
+			uint64_t hash = 0;
+			size_t i = mMinimumSize;
+			for (; i < normal; i++)
+			{
+				hash = GearHash::Roll(hash, bytes[i]);
+				if ((hash & mStrictMask) == 0)
+					return i + 1;
+			}
+
+			for (; i < limit; i++)
+			{
+				hash = GearHash::Roll(hash, bytes[i]);
+				if ((hash & mLooseMask) == 0)
+					return i + 1;
+			}
+
+			return limit;
+		}
+
+		// Calls callback with each chunk in order
+		template <typename _TCallback>
+		void Split(const void *data, size_t size, _TCallback &&callback) const
+		{
+			const uint8_t *bytes = static_cast<const uint8_t *>(data);
+			for (size_t offset = 0; offset < size;)
+			{
+				const size_t length = FindBoundary(bytes + offset, size - offset);
+				emit(bytes + offset, length, offset, callback);
+				offset += length;
+			}
+		}
+
+		template <typename _TCallback>
+		void SplitBuffer(const Buffer &buffer, _TCallback &&callback) const
+		{
+			Split(buffer.GetBuffer(), buffer.GetSize(), callback);
+		}
+
+		// Reads what is left of the stream, keeping at most the maximum chunk size
+		// plus one read in memory. The chunks are the same as for the whole data in
+		// memory. Returns false on a read error.
+		template <typename _TCallback>
+		bool Split(std::istream &stream, _TCallback &&callback) const
+		{
+			const size_t capacity = mMaximumSize + kReadSize;
+			std::unique_ptr<uint8_t[]> buffer(new uint8_t[capacity]);
+			size_t start = 0;
+			size_t end = 0;
+			uint64_t offset = 0;
+			bool finished = false;
+
+			for (;;)
+			{
+				if (!finished && end - start < mMaximumSize)
+				{
+					memmove(buffer.get(), buffer.get() + start, end - start);
+					end -= start;
+					start = 0;
+
+					stream.read(reinterpret_cast<char *>(buffer.get() + end), static_cast<std::streamsize>(capacity - end));
+					end += static_cast<size_t>(stream.gcount());
+					if (stream.bad() || (stream.fail() && !stream.eof()))
+						return false;
+
+					finished = stream.eof();
+					continue;
+				}
+
+				if (start == end)
+					return true;
+
+				const size_t length = FindBoundary(buffer.get() + start, end - start);
+				emit(buffer.get() + start, length, offset, callback);
+				start += length;
+				offset += length;
+			}
+		}
+
+		// Maps the file when possible and reads it otherwise
+		template <typename _TCallback>
+		bool SplitFile(const std::string &path, _TCallback &&callback) const
+		{
+			MappedFile file;
+			if (file.Open(path))
+			{
+				Split(file.GetData(), file.GetSize(), callback);
+				return true;
+			}
+
+			std::ifstream stream(path, std::ios::binary);
+			return stream.is_open() && Split(stream, callback);
+		}
+
+		std::vector<Chunk> Split(const void *data, size_t size) const
+		{
+			std::vector<Chunk> chunks;
+			Split(data, size, [&chunks](const Chunk &chunk) { chunks.push_back(chunk); });
+			return chunks;
+		}
+
+		size_t GetMinimumSize() const
+		{
+			return mMinimumSize;
+		}
+
+		size_t GetAverageSize() const
+		{
+			return mAverageSize;
+		}
+
+		size_t GetMaximumSize() const
+		{
+			return mMaximumSize;
+		}
+	};
+}
+
+#endif // indigo_chunker_hpp_
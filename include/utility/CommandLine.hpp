@@ -9,7 +9,8 @@
 #ifndef indigo_command_line_hpp_
 #define indigo_command_line_hpp_
 
-#include <map>
+#include "../core/FlatHashMap.hpp"
+#include "../core/String.hpp"
 #include <cstdint>
 #include <utility>
 #include <vector>
@@ -19,7 +20,7 @@ namespace indigo
 {
 	class CommandLine
 	{
-		std::map<std::string, std::string> mArguments;
+		FlatHashMap<std::string, std::string> mArguments;
 
 		static std::vector<std::string> convertToArgv(std::string commandLine)
 		{
@@ -127,13 +128,27 @@ namespace indigo
 			return mArguments.find(keyName) != mArguments.end();
 		}
 
+		// Values that are not a number give the default value
 		int64_t GetInteger(const std::string &keyName, int64_t defaultValue)
 		{
 			const auto value = mArguments.find(keyName);
 			if (value == mArguments.end())
 				return defaultValue;
 
-			return stoull(value->second, nullptr, 0);
+			int64_t result = defaultValue;
+			String::ToNumber(value->second, result);
+			return result;
+		}
+
+		float GetFloat(const std::string &keyName, float defaultValue)
+		{
+			const auto value = mArguments.find(keyName);
+			if (value == mArguments.end())
+				return defaultValue;
+
+			float result = defaultValue;
+			String::ToNumber(value->second, result);
+			return result;
 		}
 
 		std::string GetString(const std::string &keyName, std::string defaultValue)
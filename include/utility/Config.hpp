@@ -11,6 +11,7 @@
 
 #include "../core/String.hpp"
 #include <stdint.h>
+#include <algorithm>
 #include <map>
 #include <mutex>
 #include <utility>
@@ -23,25 +24,62 @@ namespace indigo
 		std::mutex mMutex;
 		std::map<std::string, std::map<std::string, std::string>> mData;
 
+		const std::string *find(const std::string &section, const std::string &key) const
+		{
+			const auto foundSection = mData.find(section);
+			if (foundSection == mData.end())
+				return nullptr;
+
+			const auto foundKey = foundSection->second.find(key);
+			return foundKey == foundSection->second.end() ? nullptr : &foundKey->second;
+		}
+
+		// Key of the n-th element of a list
+		static std::string getElementKey(const std::string &key, size_t index)
+		{
+			std::string elementKey;
+			elementKey.reserve(key.size() + 8);
+			elementKey.append(key).push_back('.');
+			String::AppendNumber(elementKey, index);
+			return elementKey;
+		}
+
+		template <typename _TValue>
+		static _TValue parseNumber(const std::string &string)
+		{
+			_TValue value = 0;
+			String::ToNumber(string, value);
+			return value;
+		}
+
+		// Number of elements of a list or map, 0 if it cannot be read
+		size_t getSize(const std::string &section, const std::string &key) const
+		{
+			const std::string *value = find(section, key);
+			size_t size = 0;
+			if (value != nullptr)
+				String::ToNumber(*value, size);
+
+			return size;
+		}
+
 	public:
 		bool Open(std::string buffer)
 		{
 			mBuffer = std::move(buffer);
-			mBuffer = String::Replace(mBuffer, "\r\n", "\n");
-
-			std::vector<std::string> lines;
-			if (String::Contains(mBuffer, "\n"))
-				lines = String::Split(mBuffer, "\n");
-			else
-				lines = String::Split(mBuffer, "\n");
 
+			// Walk the lines as views into the buffer, only keys and values that are
+			// kept get copied
 			std::string sectionName;
 			std::map<std::string, std::string> section;
-			for (auto &line : lines)
+			for (std::string_view line : String::SplitView(mBuffer, "\n"))
 			{
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+
 				if (!line.empty())
 				{
-					if (line.find_first_of('[') == 0 && line.find_last_of(']') == line.size() - 1)
+					if (line.front() == '[' && line.back() == ']')
 					{
 						if (!sectionName.empty())
 						{
@@ -49,15 +87,13 @@ namespace indigo
 							section.clear();
 						}
 
-						sectionName = line.substr(1, line.size() - 2);
+						sectionName.assign(line.substr(1, line.size() - 2));
 					}
-					else if (line.find_first_of('=') != std::string::npos)
+					else
 					{
-						size_t keyEnd = line.find_first_of('=');
-						std::string key = line.substr(0, keyEnd);
-						std::string value = line.substr(keyEnd + 1);
-						if (!key.empty())
-							section.insert(make_pair(key, value));
+						const size_t keyEnd = line.find('=');
+						if (keyEnd != std::string_view::npos && keyEnd != 0)
+							section.emplace(std::string(line.substr(0, keyEnd)), std::string(line.substr(keyEnd + 1)));
 					}
 				}
 			}
@@ -79,85 +115,105 @@ namespace indigo
 
 		bool KeyExists(const std::string &section, const std::string &key)
 		{
-			return !(mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end());
+			return find(section, key) != nullptr;
 		}
 
 		std::string GetString(const std::string &section, const std::string &key, std::string defaultValue = std::string())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			const std::string *value = find(section, key);
+			if (value == nullptr)
 			{
 				SetString(section, key, defaultValue);
 				return defaultValue;
 			}
 			
-			return mData[section][key];
+			return *value;
 		}
 
+		// Values that are not a number give the default value
 		int64_t GetInteger(const std::string &section, const std::string &key, int64_t defaultValue = 0)
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			const std::string *value = find(section, key);
+			if (value == nullptr)
 			{
 				SetInteger(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			return stoull(mData[section][key], nullptr, 0);
+			int64_t result = defaultValue;
+			String::ToNumber(*value, result);
+			return result;
 		}
 
 		float GetFloat(const std::string &section, const std::string &key, float defaultValue = 0)
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			const std::string *value = find(section, key);
+			if (value == nullptr)
 			{
 				SetFloat(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			return stof(mData[section][key]);
+			float result = defaultValue;
+			String::ToNumber(*value, result);
+			return result;
 		}
 
 		std::vector<std::string> GetStringList(const std::string &section, const std::string &key, std::vector<std::string> defaultValue = std::vector<std::string>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetStringList(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			int size = atoi(mData[section][key].c_str());
+			const size_t size = getSize(section, key);
 			std::vector<std::string> result;
-			for (int i = 0; i < size; i++)
-				result.push_back(mData[section][key + "." + std::to_string(i)]);
+			result.reserve(size);
+			for (size_t i = 0; i < size; i++)
+			{
+				const std::string *value = find(section, getElementKey(key, i));
+				result.push_back(value != nullptr ? *value : std::string());
+			}
 
 			return result;
 		}
 
 		std::vector<int64_t> GetIntegerList(const std::string &section, const std::string &key, std::vector<int64_t> defaultValue = std::vector<int64_t>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetIntegerList(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			int size = atoi(mData[section][key].c_str());
-			std::vector<int64_t> result;
-			for (int i = 0; i < size; i++)
-				result.push_back(std::stoull(mData[section][key + "." + std::to_string(i)], nullptr, 0));
+			const size_t size = getSize(section, key);
+			std::vector<int64_t> result(size, 0);
+			for (size_t i = 0; i < size; i++)
+			{
+				const std::string *value = find(section, getElementKey(key, i));
+				if (value != nullptr)
+					String::ToNumber(*value, result[i]);
+			}
 
 			return result;
 		}
 
 		std::vector<float> GetFloatList(const std::string &section, const std::string &key, std::vector<float> defaultValue = std::vector<float>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetFloatList(section, key, defaultValue);				
 				return defaultValue;
 			}
-			int size = atoi(mData[section][key].c_str());
-			std::vector<float> result;
-			for (int i = 0; i < size; i++)
-				result.push_back(std::stof(mData[section][key + "." + std::to_string(i)]));
+			const size_t size = getSize(section, key);
+			std::vector<float> result(size, 0.0f);
+			for (size_t i = 0; i < size; i++)
+			{
+				const std::string *value = find(section, getElementKey(key, i));
+				if (value != nullptr)
+					String::ToNumber(*value, result[i]);
+			}
 
 			return result;
 		}
@@ -165,13 +221,13 @@ namespace indigo
 		std::map<std::string, std::string> GetStringMap(const std::string &section, const std::string &key, std::map<std::string, std::string> defaultValue
 			                                                = std::map<std::string, std::string>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetStringMap(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			int32_t size = atoi(mData[section][key].c_str());
+			const size_t size = getSize(section, key);
 			std::map<std::string, std::string> result;
 			do
 			{
@@ -187,19 +243,19 @@ namespace indigo
 		std::map<std::string, int64_t> GetIntegerMap(const std::string &section, const std::string &key, std::map<std::string, int64_t> defaultValue
 			                                             = std::map<std::string, int64_t>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetIntegerMap(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			int32_t size = atoi(mData[section][key].c_str());
+			const size_t size = getSize(section, key);
 			std::map<std::string, int64_t> result;
 			do
 			{
 				for (auto &key_value_pair : mData[section])
 					if (key_value_pair.first != key && key_value_pair.first.find_first_of(key + ".") == 0)
-						result[key_value_pair.first.substr(key_value_pair.first.find_first_of('.'))] = stoull(key_value_pair.second, nullptr, 0);
+						result[key_value_pair.first.substr(key_value_pair.first.find_first_of('.'))] = parseNumber<int64_t>(key_value_pair.second);
 			}
 			while (result.size() != size);
 
@@ -208,19 +264,19 @@ namespace indigo
 
 		std::map<std::string, float> GetFloatMap(const std::string &section, const std::string &key, std::map<std::string, float> defaultValue = std::map<std::string, float>())
 		{
-			if (mData.find(section) == mData.end() || mData[section].find(key) == mData[section].end())
+			if (find(section, key) == nullptr)
 			{
 				SetFloatMap(section, key, defaultValue);
 				return defaultValue;
 			}
 
-			int32_t size = atoi(mData[section][key].c_str());
+			const size_t size = getSize(section, key);
 			std::map<std::string, float> result;
 			do
 			{
 				for (auto &key_value_pair : mData[section])
 					if (key_value_pair.first != key && key_value_pair.first.find_first_of(key + ".") == 0)
-						result[key_value_pair.first.substr(key_value_pair.first.find_first_of('.'))] = stof(key_value_pair.second);
+						result[key_value_pair.first.substr(key_value_pair.first.find_first_of('.'))] = parseNumber<float>(key_value_pair.second);
 			}
 			while (result.size() != size);
 
@@ -234,54 +290,55 @@ namespace indigo
 
 		void SetInteger(const std::string &section, const std::string &key, int64_t value)
 		{
-			mData[section][key] = std::to_string(value);
+			mData[section][key] = String::FromNumber(value);
 		}
 
+		// Written in the shortest form that reads back as the same value
 		void SetFloat(const std::string &section, const std::string &key, float value)
 		{
-			mData[section][key] = std::to_string(value);
+			mData[section][key] = String::FromNumber(value);
 		}
 
 		void SetStringList(const std::string &section, const std::string &key, std::vector<std::string> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (size_t i = 0; i < value.size(); i++)
-				mData[section][key + "." + std::to_string(i)] = value[i];
+				mData[section][getElementKey(key, i)] = value[i];
 		}
 
 		void SetIntegerList(const std::string &section, const std::string &key, std::vector<int64_t> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (size_t i = 0; i < value.size(); i++)
-				mData[section][key + "." + std::to_string(i)] = std::to_string(value[i]);
+				mData[section][getElementKey(key, i)] = String::FromNumber(value[i]);
 		}
 
 		void SetFloatList(const std::string &section, const std::string &key, std::vector<float> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (size_t i = 0; i < value.size(); i++)
-				mData[section][key + "." + std::to_string(i)] = std::to_string(value[i]);
+				mData[section][getElementKey(key, i)] = String::FromNumber(value[i]);
 		}
 
 		void SetStringMap(const std::string &section, const std::string &key, std::map<std::string, std::string> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (auto &pair : value)
 				mData[section][key + "." + pair.first] = pair.second;
 		}
 
 		void SetIntegerMap(const std::string &section, const std::string &key, std::map<std::string, int64_t> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (auto &pair : value)
-				mData[section][key + "." + pair.first] = std::to_string(pair.second);
+				mData[section][key + "." + pair.first] = String::FromNumber(pair.second);
 		}
 
 		void SetFloatMap(const std::string &section, const std::string &key, std::map<std::string, float> value)
 		{
-			mData[section][key] = std::to_string(value.size());
+			mData[section][key] = String::FromNumber(value.size());
 			for (auto &pair : value)
-				mData[section][key + "." + pair.first] = std::to_string(pair.second);
+				mData[section][key + "." + pair.first] = String::FromNumber(pair.second);
 		}
 
 		std::string GetBuffer()
@@ -289,19 +346,13 @@ namespace indigo
 			mBuffer.clear();
 			for (auto &section : mData)
 			{
-				mBuffer.append("[" + section.first + "]\n");
+				mBuffer.append("[").append(section.first).append("]\n");
 				for (auto &data : section.second)
-					mBuffer.append(data.first + "=" + data.second + "\n");
+					mBuffer.append(data.first).append("=").append(data.second).append("\n");
 				mBuffer.append("\n");
 			}
 
-			for (auto it = mBuffer.begin(); it != mBuffer.end();)
-			{
-				if (*it == '\0')
-					it = mBuffer.erase(it);
-				else
-					++it;
-			}
+			mBuffer.erase(std::remove(mBuffer.begin(), mBuffer.end(), '\0'), mBuffer.end());
 
 			return mBuffer;
 		}
@@ -0,0 +1,336 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_crc32_hpp_
+#define indigo_crc32_hpp_
+
+// Required libraries
+#include "../core/Cpu.hpp"
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(INDIGO_X86)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace indigo
+{
+	// Reflected 32-bit CRC with the given polynomial, pre- and post-inverted, the
+	// way zlib computes it. Long inputs are folded 64 bytes at a time with carry-less
+	// multiplies (PCLMULQDQ) when the CPU has them; the rest goes through the SSE4.2
+	// crc32 instruction for CRC32C, or slice-by-8 tables. All the constants are
+	// derived from the polynomial. Combine gives the CRC of two pieces joined
+	// together from their CRCs, so pieces can be checksummed in parallel.
+	// Example:
+	//    uint32_t crc = Crc32::Update(0, header, headerSize);
+	//    crc = Crc32::Update(crc, body, bodySize);
+	//    ...
+	//    const uint32_t whole = Crc32C::Combine(firstCrc, secondCrc, secondSize);
+	template <uint32_t _Polynomial>
+	class Crc
+	{
+		static constexpr uint32_t kCastagnoli = 0x82F63B78;
+		// Folding needs 64 bytes; for CRC32C the crc32 instruction is faster until
+		// about three times that
+		static constexpr size_t kFoldMinimum = _Polynomial == kCastagnoli ? 192 : 64;
+
+		struct Tables
+		{
+			uint32_t Slices[8][256];
+		};
+
+		// Multipliers for folding 4 x 128, 1 x 128 and 64 bits forward, and for the
+		// final Barrett reduction. Each is a 33-bit reflected value.
+		struct FoldConstants
+		{
+			alignas(16) uint64_t Fold4[2];
+			alignas(16) uint64_t Fold1[2];
+			alignas(16) uint64_t Fold64[2];
+			alignas(16) uint64_t Barrett[2];
+		};
+
+		static Tables makeTables()
+		{
+			Tables tables;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+					crc = (crc & 1) != 0 ? (crc >> 1) ^ _Polynomial : crc >> 1;
+
+				tables.Slices[0][i] = crc;
+			}
+
+			for (uint32_t i = 0; i < 256; i++)
+				for (size_t slice = 1; slice < 8; slice++)
+				{
+					const uint32_t previous = tables.Slices[slice - 1][i];
+					tables.Slices[slice][i] = (previous >> 8) ^ tables.Slices[0][previous & 0xFF];
+				}
+
+			return tables;
+		}
+
+		static const Tables &getTables()
+		{
+			static const Tables tables = makeTables();
+			return tables;
+		}
+
+		// a * b modulo the polynomial, both reflected (bit 31 is x^0)
+		static uint32_t multiplyModulo(uint32_t a, uint32_t b)
+		{
+			uint32_t product = 0;
+			for (uint32_t mask = 0x80000000; mask != 0; mask >>= 1)
+			{
+				if ((a & mask) != 0)
+				{
+					product ^= b;
+					if ((a & (mask - 1)) == 0)
+						break;
+				}
+
+				b = (b & 1) != 0 ? (b >> 1) ^ _Polynomial : b >> 1;
+			}
+
+			return product;
+		}
+
+		// x^(2^k) modulo the polynomial, for k from 0 to 31
+		static const uint32_t *getPowers()
+		{
+			struct Powers
+			{
+				uint32_t Values[32];
+
+				Powers()
+				{
+					uint32_t power = 0x40000000;
+					for (auto &value : Values)
+					{
+						value = power;
+						power = multiplyModulo(power, power);
+					}
+				}
+			};
+
+			static const Powers powers;
+			return powers.Values;
+		}
+
+		// x^(n * 2^k) modulo the polynomial
+		static uint32_t powerOfX(uint64_t n, uint32_t k)
+		{
+			const uint32_t *powers = getPowers();
+			uint32_t result = 0x80000000;
+			for (; n != 0; n >>= 1, k++)
+				if ((n & 1) != 0)
+					result = multiplyModulo(powers[k & 31], result);
+
+			return result;
+		}
+
+		static uint64_t reflect(uint64_t value, int bits)
+		{
+			uint64_t result = 0;
+			for (int i = 0; i < bits; i++)
+				if (((value >> i) & 1) != 0)
+					result |= static_cast<uint64_t>(1) << (bits - 1 - i);
+
+			return result;
+		}
+
+		static FoldConstants makeFoldConstants()
+		{
+			// x^n mod P, reflected and shifted into the 33-bit form the multiplies
+			// expect
+			auto fold = [](uint64_t n) { return static_cast<uint64_t>(powerOfX(n, 0)) << 1; };
+
+			// floor(x^64 / P) by long division with the unreflected polynomial. The
+			// first step, for x^64 itself, is done up front so the rest fits in 64 bits.
+			const uint64_t polynomial = reflect(_Polynomial, 32) | (static_cast<uint64_t>(1) << 32);
+			uint64_t quotient = static_cast<uint64_t>(1) << 32;
+			uint64_t remainder = (polynomial & 0xFFFFFFFF) << 32;
+			for (int bit = 63; bit >= 32; bit--)
+				if (((remainder >> bit) & 1) != 0)
+				{
+					quotient |= static_cast<uint64_t>(1) << (bit - 32);
+					remainder ^= polynomial << (bit - 32);
+				}
+
+			FoldConstants constants;
+			constants.Fold4[0] = fold(4 * 128 + 32);
+			constants.Fold4[1] = fold(4 * 128 - 32);
+			constants.Fold1[0] = fold(128 + 32);
+			constants.Fold1[1] = fold(128 - 32);
+			constants.Fold64[0] = fold(64);
+			constants.Fold64[1] = 0;
+			constants.Barrett[0] = (static_cast<uint64_t>(_Polynomial) << 1) | 1;
+			constants.Barrett[1] = reflect(quotient, 33);
+			return constants;
+		}
+
+		static const FoldConstants &getFoldConstants()
+		{
+			static const FoldConstants constants = makeFoldConstants();
+			return constants;
+		}
+
+		static uint32_t updateTables(uint32_t crc, const uint8_t *data, size_t size)
+		{
+			const Tables &tables = getTables();
+			for (; size >= 8; size -= 8, data += 8)
+			{
+				uint64_t word;
+				memcpy(&word, data, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				word = __builtin_bswap64(word);
+#endif
+				word ^= crc;
+				crc = tables.Slices[7][word & 0xFF] ^ tables.Slices[6][(word >> 8) & 0xFF]
+					^ tables.Slices[5][(word >> 16) & 0xFF] ^ tables.Slices[4][(word >> 24) & 0xFF]
+					^ tables.Slices[3][(word >> 32) & 0xFF] ^ tables.Slices[2][(word >> 40) & 0xFF]
+					^ tables.Slices[1][(word >> 48) & 0xFF] ^ tables.Slices[0][word >> 56];
+			}
+
+			for (; size > 0; size--, data++)
+				crc = (crc >> 8) ^ tables.Slices[0][(crc ^ *data) & 0xFF];
+
+			return crc;
+		}
+
+#if defined(INDIGO_X86)
+		// The crc32 instruction, which only knows the Castagnoli polynomial
+		INDIGO_TARGET("sse4.2")
+		static uint32_t updateSse42(uint32_t crc, const uint8_t *data, size_t size)
+		{
+#if defined(__x86_64__) || defined(_M_X64)
+			uint64_t crc64 = crc;
+			for (; size >= 8; size -= 8, data += 8)
+			{
+				uint64_t word;
+				memcpy(&word, data, sizeof(word));
+				crc64 = _mm_crc32_u64(crc64, word);
+			}
+
+			crc = static_cast<uint32_t>(crc64);
+#endif
+			for (; size >= 4; size -= 4, data += 4)
+			{
+				uint32_t word;
+				memcpy(&word, data, sizeof(word));
+				crc = _mm_crc32_u32(crc, word);
+			}
+
+			for (; size > 0; size--, data++)
+				crc = _mm_crc32_u8(crc, *data);
+
+			return crc;
+		}
+
+		INDIGO_TARGET("pclmul,sse4.1")
+		static __m128i foldInto(__m128i lane, __m128i next, __m128i multiplier)
+		{
+			const __m128i low = _mm_clmulepi64_si128(lane, multiplier, 0x00);
+			return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(lane, multiplier, 0x11), low), next);
+		}
+
+		// Folds four 128-bit lanes forward over the input, then down to one lane and
+		// Barrett-reduces it. size is a multiple of 16, at least 64.
+		INDIGO_TARGET("pclmul,sse4.1")
+		static uint32_t updateFold(uint32_t crc, const uint8_t *data, size_t size)
+		{
+			const FoldConstants &constants = getFoldConstants();
+			const __m128i *input = reinterpret_cast<const __m128i *>(data);
+
+			__m128i lane0 = _mm_xor_si128(_mm_loadu_si128(input), _mm_cvtsi32_si128(static_cast<int>(crc)));
+			__m128i lane1 = _mm_loadu_si128(input + 1);
+			__m128i lane2 = _mm_loadu_si128(input + 2);
+			__m128i lane3 = _mm_loadu_si128(input + 3);
+			input += 4;
+			size -= 64;
+
+			__m128i multiplier = _mm_load_si128(reinterpret_cast<const __m128i *>(constants.Fold4));
+			for (; size >= 64; size -= 64, input += 4)
+			{
+				const __m128i low0 = _mm_clmulepi64_si128(lane0, multiplier, 0x00);
+				const __m128i low1 = _mm_clmulepi64_si128(lane1, multiplier, 0x00);
+				const __m128i low2 = _mm_clmulepi64_si128(lane2, multiplier, 0x00);
+				const __m128i low3 = _mm_clmulepi64_si128(lane3, multiplier, 0x00);
+				lane0 = _mm_clmulepi64_si128(lane0, multiplier, 0x11);
+				lane1 = _mm_clmulepi64_si128(lane1, multiplier, 0x11);
+				lane2 = _mm_clmulepi64_si128(lane2, multiplier, 0x11);
+				lane3 = _mm_clmulepi64_si128(lane3, multiplier, 0x11);
+				lane0 = _mm_xor_si128(_mm_xor_si128(lane0, low0), _mm_loadu_si128(input));
+				lane1 = _mm_xor_si128(_mm_xor_si128(lane1, low1), _mm_loadu_si128(input + 1));
+				lane2 = _mm_xor_si128(_mm_xor_si128(lane2, low2), _mm_loadu_si128(input + 2));
+				lane3 = _mm_xor_si128(_mm_xor_si128(lane3, low3), _mm_loadu_si128(input + 3));
+			}
+
+			// Four lanes into one, then whatever 16-byte blocks are left
+			multiplier = _mm_load_si128(reinterpret_cast<const __m128i *>(constants.Fold1));
+			__m128i lane = foldInto(lane0, lane1, multiplier);
+			lane = foldInto(lane, lane2, multiplier);
+			lane = foldInto(lane, lane3, multiplier);
+			for (; size >= 16; size -= 16, input++)
+				lane = foldInto(lane, _mm_loadu_si128(input), multiplier);
+
+			// 128 bits down to 64
+			const __m128i mask = _mm_setr_epi32(-1, 0, -1, 0);
+			lane = _mm_xor_si128(_mm_srli_si128(lane, 8), _mm_clmulepi64_si128(lane, multiplier, 0x10));
+			multiplier = _mm_load_si128(reinterpret_cast<const __m128i *>(constants.Fold64));
+			lane = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(lane, mask), multiplier, 0x00), _mm_srli_si128(lane, 4));
+
+			// Barrett reduction to 32 bits
+			multiplier = _mm_load_si128(reinterpret_cast<const __m128i *>(constants.Barrett));
+			__m128i reduced = _mm_clmulepi64_si128(_mm_and_si128(lane, mask), multiplier, 0x10);
+			reduced = _mm_clmulepi64_si128(_mm_and_si128(reduced, mask), multiplier, 0x00);
+			return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(lane, reduced), 1));
+		}
+#endif
+
+	public:
+		// Continues crc over the data; start with 0
+		static uint32_t Update(uint32_t crc, const void *data, size_t size)
+		{
+			auto *input = static_cast<const uint8_t *>(data);
+			crc = ~crc;
+
+#if defined(INDIGO_X86)
+			if (size >= kFoldMinimum && Cpu::HasFeature(Cpu::kFeature_Pclmul) && Cpu::HasFeature(Cpu::kFeature_Sse41))
+			{
+				const size_t folded = size & ~static_cast<size_t>(15);
+				crc = updateFold(crc, input, folded);
+				input += folded;
+				size -= folded;
+			}
+
+			if constexpr (_Polynomial == kCastagnoli)
+				if (Cpu::HasFeature(Cpu::kFeature_Sse42))
+					return ~updateSse42(crc, input, size);
+#endif
+
+			return ~updateTables(crc, input, size);
+		}
+
+		// The CRC of A followed by B, from the CRC of A, the CRC of B and the size of B
+		static uint32_t Combine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+		{
+			return multiplyModulo(powerOfX(size2, 3), crc1) ^ crc2;
+		}
+	};
+
+	// zlib, PNG, gzip, Ethernet
+	typedef Crc<0xEDB88320> Crc32;
+	// iSCSI, ext4, SCTP
+	typedef Crc<0x82F63B78> Crc32C;
+}
+
+#endif // indigo_crc32_hpp_
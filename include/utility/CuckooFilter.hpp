@@ -0,0 +1,346 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_cuckoo_filter_hpp_
+#define indigo_cuckoo_filter_hpp_
+
+// Required libraries
+#include "../core/Buffer.hpp"
+#include "Hash.hpp"
+#include <cstring>
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Cuckoo filter: a set membership filter like BloomFilter that also supports
+	// removing keys. Every key stores a 16-bit fingerprint in one of two buckets
+	// of four, so a query reads two 8-byte buckets and checks each one's four
+	// fingerprints with a single word compare. Inserting evicts fingerprints to
+	// their other bucket when both are full. When full, about 1 in 8000 absent
+	// keys is reported present. Only remove keys that were inserted; removing
+	// anything else can drop another key's fingerprint.
+	// Example:
+	//    CuckooFilter cached(1 << 20);
+	//    cached.Insert(url);
+	//    ...
+	//    cached.Remove(url);
+	class CuckooFilter
+	{
+		static constexpr uint32_t kMagic = 0x464B4349;
+		static constexpr uint32_t kVersion = 1;
+		static constexpr size_t kHeaderSize = 64;
+		static constexpr size_t kBucketSize = 4;
+		static constexpr size_t kMaxKicks = 500;
+		static constexpr uint64_t kLanes = 0x0001000100010001;
+		static constexpr uint64_t kVictimUsed = 1ull << 63;
+
+		// A bucket is four 16-bit fingerprints in one word, 0 marking a free slot
+		std::vector<uint64_t> mStorage;
+		const uint64_t *mView;
+		size_t mBucketMask;
+		uint64_t mCount;
+		// A fingerprint that lost its slot when an insert ran out of kicks, with
+		// its bucket. While it is held, the filter is full.
+		uint64_t mVictim;
+		uint64_t mRandom;
+
+		const uint64_t *getBuckets() const
+		{
+			return mView != nullptr ? mView : mStorage.data();
+		}
+
+		static uint16_t getFingerprint(uint64_t hash)
+		{
+			const uint16_t fingerprint = static_cast<uint16_t>(hash);
+			return fingerprint != 0 ? fingerprint : 1;
+		}
+
+		// Going from either bucket to the other only needs the fingerprint
+		size_t getAlternate(size_t bucket, uint16_t fingerprint) const
+		{
+			return (bucket ^ static_cast<size_t>(fingerprint * 0x5BD1E995u)) & mBucketMask;
+		}
+
+		// Whether any 16-bit lane of bucket equals fingerprint
+		static bool hasFingerprint(uint64_t bucket, uint16_t fingerprint)
+		{
+			const uint64_t difference = bucket ^ (kLanes * fingerprint);
+			return ((difference - kLanes) & ~difference & (kLanes << 15)) != 0;
+		}
+
+		static uint16_t getSlot(uint64_t bucket, size_t slot)
+		{
+			return static_cast<uint16_t>(bucket >> (16 * slot));
+		}
+
+		static void setSlot(uint64_t &bucket, size_t slot, uint16_t fingerprint)
+		{
+			bucket = (bucket & ~(0xFFFFull << (16 * slot))) | static_cast<uint64_t>(fingerprint) << (16 * slot);
+		}
+
+		bool tryStore(size_t bucket, uint16_t fingerprint)
+		{
+			for (size_t slot = 0; slot < kBucketSize; slot++)
+				if (getSlot(mStorage[bucket], slot) == 0)
+				{
+					setSlot(mStorage[bucket], slot, fingerprint);
+					return true;
+				}
+
+			return false;
+		}
+
+		bool tryClear(size_t bucket, uint16_t fingerprint)
+		{
+			for (size_t slot = 0; slot < kBucketSize; slot++)
+				if (getSlot(mStorage[bucket], slot) == fingerprint)
+				{
+					setSlot(mStorage[bucket], slot, 0);
+					return true;
+				}
+
+			return false;
+		}
+
+		// Moves fingerprints to their other bucket until one finds a free slot
+		void store(size_t bucket, uint16_t fingerprint)
+		{
+			if (tryStore(bucket, fingerprint) || tryStore(getAlternate(bucket, fingerprint), fingerprint))
+				return;
+
+			for (size_t kick = 0; kick < kMaxKicks; kick++)
+			{
+				mRandom ^= mRandom << 13;
+				mRandom ^= mRandom >> 7;
+				mRandom ^= mRandom << 17;
+				const size_t slot = static_cast<size_t>(mRandom % kBucketSize);
+
+				const uint16_t evicted = getSlot(mStorage[bucket], slot);
+				setSlot(mStorage[bucket], slot, fingerprint);
+				fingerprint = evicted;
+				bucket = getAlternate(bucket, fingerprint);
+				if (tryStore(bucket, fingerprint))
+					return;
+			}
+
+			mVictim = kVictimUsed | static_cast<uint64_t>(bucket) << 16 | fingerprint;
+		}
+
+		bool victimMatches(size_t first, size_t second, uint16_t fingerprint) const
+		{
+			if ((mVictim & kVictimUsed) == 0 || static_cast<uint16_t>(mVictim) != fingerprint)
+				return false;
+
+			const size_t bucket = static_cast<size_t>((mVictim & ~kVictimUsed) >> 16);
+			return bucket == first || bucket == second;
+		}
+
+		void makeWritable()
+		{
+			if (mView == nullptr)
+				return;
+
+			mStorage.assign(mView, mView + mBucketMask + 1);
+			mView = nullptr;
+		}
+
+	public:
+		// Room for at least capacity keys at 95% load, the most a cuckoo filter
+		// with four-slot buckets reliably reaches
+		explicit CuckooFilter(size_t capacity = 0)
+			: mView(nullptr), mCount(0), mVictim(0), mRandom(0x9E3779B97F4A7C15)
+		{
+			size_t buckets = 1;
+			while (buckets * kBucketSize * 95 < capacity * 100)
+				buckets *= 2;
+
+			mBucketMask = buckets - 1;
+			mStorage.assign(buckets, 0);
+		}
+
+		// Returns false if the filter is full. The key is still found afterwards,
+		// but nothing more can be inserted until something is removed.
+		bool InsertHash(uint64_t hash)
+		{
+			if ((mVictim & kVictimUsed) != 0)
+				return false;
+
+			makeWritable();
+			const uint16_t fingerprint = getFingerprint(hash);
+			store(static_cast<size_t>(hash >> 32) & mBucketMask, fingerprint);
+			mCount++;
+			return (mVictim & kVictimUsed) == 0;
+		}
+
+		bool ContainsHash(uint64_t hash) const
+		{
+			const uint16_t fingerprint = getFingerprint(hash);
+			const size_t first = static_cast<size_t>(hash >> 32) & mBucketMask;
+			const size_t second = getAlternate(first, fingerprint);
+			const uint64_t *buckets = getBuckets();
+			return hasFingerprint(buckets[first], fingerprint) || hasFingerprint(buckets[second], fingerprint) || victimMatches(first, second, fingerprint);
+		}
+
+		// Returns false if the key was not found
+		bool RemoveHash(uint64_t hash)
+		{
+			const uint16_t fingerprint = getFingerprint(hash);
+			const size_t first = static_cast<size_t>(hash >> 32) & mBucketMask;
+			const size_t second = getAlternate(first, fingerprint);
+			makeWritable();
+
+			if (victimMatches(first, second, fingerprint))
+			{
+				mVictim = 0;
+				mCount--;
+				return true;
+			}
+
+			if (!tryClear(first, fingerprint) && !tryClear(second, fingerprint))
+				return false;
+
+			mCount--;
+
+			// The freed slot may give the victim a place again
+			if ((mVictim & kVictimUsed) != 0)
+			{
+				const uint64_t victim = mVictim;
+				mVictim = 0;
+				store(static_cast<size_t>((victim & ~kVictimUsed) >> 16), static_cast<uint16_t>(victim));
+			}
+
+			return true;
+		}
+
+		bool Insert(const void *data, size_t size)
+		{
+			return InsertHash(Hash::XXH3_64(static_cast<const uint8_t *>(data), size));
+		}
+
+		bool Insert(std::string_view key)
+		{
+			return Insert(key.data(), key.size());
+		}
+
+		bool Contains(const void *data, size_t size) const
+		{
+			return ContainsHash(Hash::XXH3_64(static_cast<const uint8_t *>(data), size));
+		}
+
+		bool Contains(std::string_view key) const
+		{
+			return Contains(key.data(), key.size());
+		}
+
+		bool Remove(const void *data, size_t size)
+		{
+			return RemoveHash(Hash::XXH3_64(static_cast<const uint8_t *>(data), size));
+		}
+
+		bool Remove(std::string_view key)
+		{
+			return Remove(key.data(), key.size());
+		}
+
+		void Clear()
+		{
+			mStorage.assign(mBucketMask + 1, 0);
+			mView = nullptr;
+			mCount = 0;
+			mVictim = 0;
+		}
+
+		uint64_t GetCount() const
+		{
+			return mCount;
+		}
+
+		size_t GetBucketCount() const
+		{
+			return mBucketMask + 1;
+		}
+
+		size_t GetSerializedSize() const
+		{
+			return kHeaderSize + (mBucketMask + 1) * sizeof(uint64_t);
+		}
+
+		// A 64-byte header followed by the buckets, in the host's byte order
+		void Serialize(Buffer &buffer) const
+		{
+			buffer.Write(kMagic);
+			buffer.Write(kVersion);
+			buffer.Write(static_cast<uint64_t>(mBucketMask + 1));
+			buffer.Write(mCount);
+			buffer.Write(mVictim);
+			for (size_t i = 32; i < kHeaderSize; i += 8)
+				buffer.Write(static_cast<uint64_t>(0));
+
+			buffer.WriteArray(getBuckets(), mBucketMask + 1);
+		}
+
+		bool Deserialize(Buffer &buffer)
+		{
+			uint32_t magic, version;
+			uint64_t bucketCount, count, victim, padding;
+			if (!buffer.Read(&magic) || !buffer.Read(&version) || !buffer.Read(&bucketCount) || !buffer.Read(&count) || !buffer.Read(&victim))
+				return false;
+
+			if (magic != kMagic || version != kVersion || bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+				|| bucketCount > (buffer.GetSize() - buffer.GetPosition()) / sizeof(uint64_t))
+				return false;
+
+			for (size_t i = 32; i < kHeaderSize; i += 8)
+				if (!buffer.Read(&padding))
+					return false;
+
+			std::vector<uint64_t> storage(static_cast<size_t>(bucketCount));
+			if (!buffer.ReadArray(storage.data(), storage.size()))
+				return false;
+
+			mStorage.swap(storage);
+			mView = nullptr;
+			mBucketMask = static_cast<size_t>(bucketCount - 1);
+			mCount = count;
+			mVictim = victim;
+			return true;
+		}
+
+		// Queries the serialized filter in place, like BloomFilter::Attach. The
+		// memory has to be 8-byte aligned; removing or inserting takes a copy.
+		bool Attach(const void *data, size_t size)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t *>(data);
+			if (size < kHeaderSize || reinterpret_cast<uintptr_t>(bytes) % alignof(uint64_t) != 0)
+				return false;
+
+			uint32_t magic, version;
+			uint64_t bucketCount, count, victim;
+			memcpy(&magic, bytes, 4);
+			memcpy(&version, bytes + 4, 4);
+			memcpy(&bucketCount, bytes + 8, 8);
+			memcpy(&count, bytes + 16, 8);
+			memcpy(&victim, bytes + 24, 8);
+			if (magic != kMagic || version != kVersion || bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+				|| bucketCount > (size - kHeaderSize) / sizeof(uint64_t))
+				return false;
+
+			std::vector<uint64_t>().swap(mStorage);
+			mView = reinterpret_cast<const uint64_t *>(bytes + kHeaderSize);
+			mBucketMask = static_cast<size_t>(bucketCount - 1);
+			mCount = count;
+			mVictim = victim;
+			return true;
+		}
+	};
+}
+
+#endif // indigo_cuckoo_filter_hpp_
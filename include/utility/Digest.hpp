@@ -0,0 +1,75 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_digest_hpp_
+#define indigo_digest_hpp_
+
+// Required libraries
+#include "Hex.hpp"
+#include <array>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Fixed-size hash result. It is a plain byte array, so it compares, copies and
+	// indexes like one, and converts to and from lowercase hex text. As the bytes
+	// are already well mixed, std::hash just takes the first eight of them.
+	// Example:
+	//    const Sha256::Digest digest = Sha256::Compute(data, size);
+	//    manifest[path] = digest.ToString();
+	//    Sha256::Digest expected;
+	//    if (!Digest256::Parse(line, expected))
+	//        ...
+	template <size_t _Size>
+	class Digest : public std::array<uint8_t, _Size>
+	{
+	public:
+		static constexpr size_t kTextSize = 2 * _Size;
+
+		// Writes kTextSize characters, without a terminator
+		void ToChars(char *output, bool upperCase = false) const
+		{
+			Hex::Encode(this->data(), _Size, output, upperCase);
+		}
+
+		std::string ToString(bool upperCase = false) const
+		{
+			return Hex::Encode(this->data(), _Size, upperCase);
+		}
+
+		// Accepts exactly kTextSize hex digits in either case
+		static bool Parse(std::string_view text, Digest &digest)
+		{
+			return text.size() == kTextSize && Hex::Decode(text.data(), text.size(), digest.data());
+		}
+	};
+
+	typedef Digest<16> Digest128;
+	typedef Digest<32> Digest256;
+}
+
+namespace std
+{
+	template <size_t _Size>
+	struct hash<indigo::Digest<_Size>>
+	{
+		size_t operator()(const indigo::Digest<_Size> &digest) const
+		{
+			uint64_t value = 0;
+			memcpy(&value, digest.data(), _Size < sizeof(value) ? _Size : sizeof(value));
+			return static_cast<size_t>(value);
+		}
+	};
+}
+
+#endif // indigo_digest_hpp_
@@ -10,20 +10,120 @@
 #define indigo_hash_hpp_
 
 #include "../core/String.hpp"
+#include "Crc32.hpp"
+#include "Hex.hpp"
+#include "MappedFile.hpp"
+#include "Sha256.hpp"
+#include "XXHash.hpp"
 #include <iostream>
+#include <memory>
+#include <string_view>
 #include <stdint.h>
+#include <stdio.h>
+
+#if !defined(OS_WIN)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace indigo
 {
+	// Hash functions over memory, streams and files. Every algorithm has a function
+	// for hashing data in one go and a hasher object for hashing it piece by piece;
+	// both give the same result. The hashers all have Update(data, size),
+	// Update(string_view), Finalize() and Reset(), so code taking a hasher as a
+	// template parameter works with any of them.
+	// Example:
+	//    uint64_t hash;
+	//    if (Hash::File<Hash::XXH3_64Hasher>(path, hash))
+	//        ...
+	//    Hash::FNV1A_64Hasher hasher;
+	//    for (auto &part : parts)
+	//        hasher.Update(part);
+	//    const uint64_t key = hasher.Finalize();
 	class Hash
 	{
+		static constexpr size_t kStreamBufferSize = 64 * 1024;
+		static constexpr size_t kFileBufferSize = 1024 * 1024;
+
+		// Allocated once per thread, so reading a stream allocates nothing
+		static char *getStreamBuffer()
+		{
+			static thread_local std::unique_ptr<char[]> buffer;
+			if (!buffer)
+				buffer.reset(new char[kStreamBufferSize]);
+
+			return buffer.get();
+		}
+
+		template <typename _THasher>
+		static void update(_THasher &hasher, std::istream &stream)
+		{
+			char *buffer = getStreamBuffer();
+			while (stream)
+			{
+				stream.read(buffer, kStreamBufferSize);
+				hasher.Update(buffer, static_cast<size_t>(stream.gcount()));
+			}
+		}
+
+		// For files that cannot be mapped, e.g. pipes. Reads in large blocks straight
+		// into our buffer, with the OS told to read ahead.
+		template <typename _THasher>
+		static bool update(_THasher &hasher, const std::string &path)
+		{
+			std::unique_ptr<char[]> buffer(new char[kFileBufferSize]);
+#if defined(OS_WIN)
+			FILE *file = fopen(path.c_str(), "rb");
+			if (file == nullptr)
+				return false;
+
+			setvbuf(file, nullptr, _IONBF, 0);
+			size_t read;
+			while ((read = fread(buffer.get(), 1, kFileBufferSize, file)) > 0)
+				hasher.Update(buffer.get(), read);
+
+			const bool result = ferror(file) == 0;
+			fclose(file);
+			return result;
+#else
+			const int descriptor = open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+				return false;
+
+#if defined(OS_LINUX)
+			posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+			ssize_t read;
+			while ((read = ::read(descriptor, buffer.get(), kFileBufferSize)) != 0)
+			{
+				if (read < 0)
+				{
+					if (errno == EINTR)
+						continue;
+
+					close(descriptor);
+					return false;
+				}
+
+				hasher.Update(buffer.get(), static_cast<size_t>(read));
+			}
+
+			close(descriptor);
+			return true;
+#endif
+		}
+
 	public:
 		static const uint32_t FNV1A_Prime32 = 0x01000193;
 		static const uint32_t FNV1A_Offset32 = 0x811C9DC5;
 		static const uint64_t FNV1A_Prime64 = 0x00000100000001B3;
 		static const uint64_t FNV1A_Offset64 = 0xCBF29CE484222325;
 
-		static uint32_t FNV1A_32(uint8_t *obj, size_t size, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
+		// The multiply comes before the xor, as it always has here, so hashes stay
+		// the same as the ones already stored. All overloads give the same result.
+		static constexpr uint32_t FNV1A_32(const uint8_t *obj, size_t size, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
 		{
 			uint32_t hash = offset;
 			for (size_t i = 0; i < size; i++)
@@ -35,7 +135,7 @@ namespace indigo
 			return hash;
 		}
 
-		static uint64_t FNV1A_64(uint8_t *obj, size_t size, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
+		static constexpr uint64_t FNV1A_64(const uint8_t *obj, size_t size, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
 		{
 			uint64_t hash = offset;
 			for (size_t i = 0; i < size; i++)
@@ -47,59 +147,374 @@ namespace indigo
 			return hash;
 		}
 
-		static uint32_t FNV1A_32(std::string &obj, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
+		// Any other buffer, so char pointers do not convert to the string_view
+		// overloads and take the size as the prime
+		static uint32_t FNV1A_32(const void *obj, size_t size, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
 		{
-			return FNV1A_32(reinterpret_cast<uint8_t *>(const_cast<char *>(obj.c_str())), obj.size(), prime, offset);
+			return FNV1A_32(static_cast<const uint8_t *>(obj), size, prime, offset);
 		}
 
-		static uint64_t FNV1A_64(std::string &obj, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
+		static uint64_t FNV1A_64(const void *obj, size_t size, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
 		{
-			return FNV1A_64(reinterpret_cast<uint8_t *>(const_cast<char *>(obj.c_str())), obj.size(), prime, offset);
+			return FNV1A_64(static_cast<const uint8_t *>(obj), size, prime, offset);
 		}
 
-		static uint32_t FNV1A_32(std::istream &stream, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
+		// Usable in constant expressions, e.g. for case labels; see also the _fnv32
+		// and _fnv64 literals
+		static constexpr uint32_t FNV1A_32(std::string_view obj, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
 		{
-			size_t buffer_size = 1024 * 1024;
-			auto *buffer = new char[buffer_size];
 			uint32_t hash = offset;
-			while (!stream.eof())
+			for (char character : obj)
 			{
-				stream.read(buffer, buffer_size);
-				hash = FNV1A_32(reinterpret_cast<uint8_t *>(buffer), stream.gcount(), prime, hash);
+				hash *= prime;
+				hash ^= static_cast<uint8_t>(character);
 			}
-			delete[] buffer;
 
 			return hash;
 		}
 
-		static uint64_t FNV1A_64(std::istream &stream, uint32_t prime = FNV1A_Prime64, uint32_t offset = FNV1A_Offset64)
+		static constexpr uint64_t FNV1A_64(std::string_view obj, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
 		{
-			size_t buffer_size = 1024 * 1024;
-			auto *buffer = new char[buffer_size];
 			uint64_t hash = offset;
-			while (!stream.eof())
+			for (char character : obj)
 			{
-				stream.read(buffer, buffer_size);
-				hash = FNV1A_64(reinterpret_cast<uint8_t *>(buffer), stream.gcount(), prime, hash);
+				hash *= prime;
+				hash ^= static_cast<uint8_t>(character);
 			}
-			delete[] buffer;
 
 			return hash;
 		}
 
+		// XXH64 and XXH3 run at several GB/s, far faster than FNV on anything but
+		// tiny keys. XXH3 is the faster of the two, on short inputs as well.
+		static uint64_t XXH64(const void *obj, size_t size, uint64_t seed = 0)
+		{
+			return XXHash::XXH64(obj, size, seed);
+		}
+
+		static uint64_t XXH3_64(const void *obj, size_t size, uint64_t seed = 0)
+		{
+			return XXHash::XXH3_64(obj, size, seed);
+		}
+
+		static uint64_t XXH64(std::string_view obj, uint64_t seed = 0)
+		{
+			return XXHash::XXH64(obj.data(), obj.size(), seed);
+		}
+
+		static uint64_t XXH3_64(std::string_view obj, uint64_t seed = 0)
+		{
+			return XXHash::XXH3_64(obj.data(), obj.size(), seed);
+		}
+
+		// Checksums compatible with zlib's crc32() and with CRC32C (Castagnoli).
+		// Pass a previous result as crc to continue it.
+		static uint32_t CRC32(const void *obj, size_t size, uint32_t crc = 0)
+		{
+			return Crc32::Update(crc, obj, size);
+		}
+
+		static uint32_t CRC32C(const void *obj, size_t size, uint32_t crc = 0)
+		{
+			return Crc32C::Update(crc, obj, size);
+		}
+
+		static uint32_t CRC32(std::string_view obj, uint32_t crc = 0)
+		{
+			return Crc32::Update(crc, obj.data(), obj.size());
+		}
+
+		static uint32_t CRC32C(std::string_view obj, uint32_t crc = 0)
+		{
+			return Crc32C::Update(crc, obj.data(), obj.size());
+		}
+
+		// The CRC of two pieces joined together, from the CRCs of both and the size
+		// of the second one
+		static uint32_t CRC32_Combine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+		{
+			return Crc32::Combine(crc1, crc2, size2);
+		}
+
+		static uint32_t CRC32C_Combine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+		{
+			return Crc32C::Combine(crc1, crc2, size2);
+		}
+
+		// Sha256::HashMany hashes many independent buffers faster than one by one
+		static Sha256::Digest SHA256(const void *obj, size_t size)
+		{
+			return Sha256::Compute(obj, size);
+		}
+
+		static Sha256::Digest SHA256(std::string_view obj)
+		{
+			return Sha256::Compute(obj.data(), obj.size());
+		}
+
+		class FNV1A_32Hasher
+		{
+			uint32_t mPrime;
+			uint32_t mOffset;
+			uint32_t mHash;
+
+		public:
+			using Result = uint32_t;
+
+			explicit FNV1A_32Hasher(uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
+				: mPrime(prime), mOffset(offset), mHash(offset) { }
+
+			void Update(const void *data, size_t size)
+			{
+				mHash = FNV1A_32(static_cast<const uint8_t *>(data), size, mPrime, mHash);
+			}
+
+			void Update(std::string_view data)
+			{
+				Update(data.data(), data.size());
+			}
+
+			// Does not reset the hasher, more data can still be added
+			uint32_t Finalize() const
+			{
+				return mHash;
+			}
+
+			void Reset()
+			{
+				mHash = mOffset;
+			}
+		};
+
+		class FNV1A_64Hasher
+		{
+			uint64_t mPrime;
+			uint64_t mOffset;
+			uint64_t mHash;
+
+		public:
+			using Result = uint64_t;
+
+			explicit FNV1A_64Hasher(uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
+				: mPrime(prime), mOffset(offset), mHash(offset) { }
+
+			void Update(const void *data, size_t size)
+			{
+				mHash = FNV1A_64(static_cast<const uint8_t *>(data), size, mPrime, mHash);
+			}
+
+			void Update(std::string_view data)
+			{
+				Update(data.data(), data.size());
+			}
+
+			uint64_t Finalize() const
+			{
+				return mHash;
+			}
+
+			void Reset()
+			{
+				mHash = mOffset;
+			}
+		};
+
+		class XXH64Hasher
+		{
+			uint64_t mSeed;
+			XXHash::XXH64State mState;
+
+		public:
+			using Result = uint64_t;
+
+			explicit XXH64Hasher(uint64_t seed = 0) : mSeed(seed), mState(seed) { }
+
+			void Update(const void *data, size_t size)
+			{
+				mState.Update(data, size);
+			}
+
+			void Update(std::string_view data)
+			{
+				mState.Update(data.data(), data.size());
+			}
+
+			uint64_t Finalize() const
+			{
+				return mState.Digest();
+			}
+
+			void Reset()
+			{
+				mState.Reset(mSeed);
+			}
+		};
+
+		class XXH3_64Hasher
+		{
+			uint64_t mSeed;
+			XXHash::XXH3State mState;
+
+		public:
+			using Result = uint64_t;
+
+			explicit XXH3_64Hasher(uint64_t seed = 0) : mSeed(seed), mState(seed) { }
+
+			void Update(const void *data, size_t size)
+			{
+				mState.Update(data, size);
+			}
+
+			void Update(std::string_view data)
+			{
+				mState.Update(data.data(), data.size());
+			}
+
+			uint64_t Finalize() const
+			{
+				return mState.Digest();
+			}
+
+			void Reset()
+			{
+				mState.Reset(mSeed);
+			}
+		};
+
+		template <typename _TCrc>
+		class CRCHasher
+		{
+			uint32_t mCrc;
+
+		public:
+			using Result = uint32_t;
+
+			CRCHasher() : mCrc(0) { }
+
+			void Update(const void *data, size_t size)
+			{
+				mCrc = _TCrc::Update(mCrc, data, size);
+			}
+
+			void Update(std::string_view data)
+			{
+				Update(data.data(), data.size());
+			}
+
+			uint32_t Finalize() const
+			{
+				return mCrc;
+			}
+
+			void Reset()
+			{
+				mCrc = 0;
+			}
+		};
+
+		typedef CRCHasher<Crc32> CRC32Hasher;
+		typedef CRCHasher<Crc32C> CRC32CHasher;
+		typedef Sha256 SHA256Hasher;
+
+		// Hashes what is left of the stream
+		template <typename _THasher>
+		static typename _THasher::Result Stream(std::istream &stream, _THasher hasher = _THasher())
+		{
+			update(hasher, stream);
+			return hasher.Finalize();
+		}
+
+		// Hashes the whole file, mapped into memory so it is never copied. Files that
+		// cannot be mapped are read instead. Returns false if the file cannot be read.
+		template <typename _THasher>
+		static bool File(const std::string &path, typename _THasher::Result &result, _THasher hasher = _THasher())
+		{
+			MappedFile file;
+			if (file.Open(path))
+				hasher.Update(file.GetData(), file.GetSize());
+			else if (!update(hasher, path))
+				return false;
+
+			result = hasher.Finalize();
+			return true;
+		}
+
+		static uint32_t FNV1A_32(std::istream &stream, uint32_t prime = FNV1A_Prime32, uint32_t offset = FNV1A_Offset32)
+		{
+			return Stream(stream, FNV1A_32Hasher(prime, offset));
+		}
+
+		static uint64_t FNV1A_64(std::istream &stream, uint64_t prime = FNV1A_Prime64, uint64_t offset = FNV1A_Offset64)
+		{
+			return Stream(stream, FNV1A_64Hasher(prime, offset));
+		}
+
+		static uint32_t CRC32(std::istream &stream)
+		{
+			return Stream<CRC32Hasher>(stream);
+		}
+
+		static uint32_t CRC32C(std::istream &stream)
+		{
+			return Stream<CRC32CHasher>(stream);
+		}
+
+		static Sha256::Digest SHA256(std::istream &stream)
+		{
+			return Stream<SHA256Hasher>(stream);
+		}
+
+		static uint64_t XXH64(std::istream &stream, uint64_t seed = 0)
+		{
+			return Stream(stream, XXH64Hasher(seed));
+		}
+
+		static uint64_t XXH3_64(std::istream &stream, uint64_t seed = 0)
+		{
+			return Stream(stream, XXH3_64Hasher(seed));
+		}
+
+		// Hex of the value's bytes in memory order, in uppercase
 		template <typename _TData>
-		static std::string GetString(_TData hash)
+		static std::string GetString(const _TData &hash)
 		{
-			std::string result;
-			result.resize(sizeof(hash) * 2);
-			fill(result.begin(), result.end(), 0);
-			uint8_t *src = reinterpret_cast<uint8_t *>(&hash);
-			for (size_t i = 0; i < sizeof(hash); i++)
-				sprintf_s(const_cast<char *>(result.c_str() + i * 2), result.size(), "%02X", src[i]);
+			return Hex::Encode(&hash, sizeof(hash), true);
+		}
 
-			return result;
+		// Reads back what GetString wrote, in either case
+		template <typename _TData>
+		static bool FromString(std::string_view text, _TData &hash)
+		{
+			return text.size() == sizeof(hash) * 2 && Hex::Decode(text.data(), text.size(), &hash);
 		}
 	};
+
+	// Compile-time FNV hashes of string literals.
+	// Example:
+	//    switch (Hash::FNV1A_32(name))
+	//    {
+	//    case "player.health"_fnv32:
+	//        ...
+	inline namespace literals
+	{
+		constexpr uint32_t operator""_fnv32(const char *string, size_t size)
+		{
+			return Hash::FNV1A_32(std::string_view(string, size));
+		}
+
+		constexpr uint64_t operator""_fnv64(const char *string, size_t size)
+		{
+			return Hash::FNV1A_64(std::string_view(string, size));
+		}
+	}
+
+	static_assert(""_fnv32 == Hash::FNV1A_Offset32 && ""_fnv64 == Hash::FNV1A_Offset64, "FNV of nothing is the offset");
+	static_assert("player.health"_fnv32 == 0xF85F48F2 && "player.health"_fnv64 == 0x511FA99DBE1202F2, "FNV literals changed");
+	static_assert([]
+	{
+		const uint8_t bytes[] = {'p', 'l', 'a', 'y', 'e', 'r', '.', 'h', 'e', 'a', 'l', 't', 'h'};
+		return Hash::FNV1A_32(bytes, sizeof(bytes)) == "player.health"_fnv32 && Hash::FNV1A_64(bytes, sizeof(bytes)) == "player.health"_fnv64;
+	}(), "FNV overloads differ");
 }
 
 #endif // indigo_hash_hpp_
@@ -0,0 +1,258 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_hash_tree_hpp_
+#define indigo_hash_tree_hpp_
+
+// Required libraries
+#include "../core/Latch.hpp"
+#include "../core/ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "XXHash.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Tree hash for large files. The data is cut into fixed-size leaves, each leaf
+	// is hashed with XXH3, and the root is the hash of the total size, the leaf
+	// size and the leaf hashes in order. Leaves can be hashed on a thread pool;
+	// the boundaries only depend on the leaf size, so the root is the same for any
+	// number of threads. After a change only the leaves it touches are hashed again.
+	// The root is only comparable between trees with the same leaf size.
+	// Example:
+	//    ThreadPool pool;
+	//    HashTree tree;
+	//    if (tree.BuildFile(path, pool) && tree.GetRoot() != expectedRoot)
+	//        ...
+	//    tree.Update(data, size, changedOffset, changedLength);
+	class HashTree
+	{
+		// Leaves still to be hashed, shared with the pool tasks. Tasks that only
+		// start once every leaf is done find nothing left and touch nothing else.
+		struct Job
+		{
+			const uint8_t *Data;
+			uint64_t Size;
+			size_t LeafSize;
+			uint64_t *Leaves;
+			std::atomic<size_t> Next;
+			size_t Last;
+			Latch Done;
+
+			Job(const uint8_t *data, uint64_t size, size_t leafSize, uint64_t *leaves, size_t first, size_t last)
+				: Data(data), Size(size), LeafSize(leafSize), Leaves(leaves), Next(first), Last(last),
+				  Done(static_cast<uint32_t>(last - first)) { }
+
+			void Run()
+			{
+				for (size_t leaf = Next.fetch_add(1, std::memory_order_relaxed); leaf < Last; leaf = Next.fetch_add(1, std::memory_order_relaxed))
+				{
+					Leaves[leaf] = hashLeaf(Data, Size, LeafSize, leaf);
+					Done.CountDown();
+				}
+			}
+		};
+
+		size_t mLeafSize;
+		uint64_t mSize;
+		std::vector<uint64_t> mLeaves;
+		uint64_t mRoot;
+
+		static uint64_t hashLeaf(const uint8_t *data, uint64_t size, size_t leafSize, size_t leaf)
+		{
+			const uint64_t offset = static_cast<uint64_t>(leaf) * leafSize;
+			const uint64_t remaining = size - offset;
+			return XXHash::XXH3_64(data + offset, static_cast<size_t>(remaining < leafSize ? remaining : leafSize));
+		}
+
+		static void writeLittleEndian(uint8_t *output, uint64_t value)
+		{
+			for (size_t i = 0; i < 8; i++)
+				output[i] = static_cast<uint8_t>(value >> (8 * i));
+		}
+
+		size_t getLeafCount(uint64_t size) const
+		{
+			return static_cast<size_t>((size + mLeafSize - 1) / mLeafSize);
+		}
+
+		// Hashes leaves [first, last), with the calling thread helping the pool
+		void hashLeaves(const uint8_t *data, size_t first, size_t last, ThreadPool *pool)
+		{
+			if (pool == nullptr || last - first < 2)
+			{
+				for (size_t leaf = first; leaf < last; leaf++)
+					mLeaves[leaf] = hashLeaf(data, mSize, mLeafSize, leaf);
+
+				return;
+			}
+
+			auto job = std::make_shared<Job>(data, mSize, mLeafSize, mLeaves.data(), first, last);
+			const size_t helpers = pool->GetThreadCount() < last - first - 1 ? pool->GetThreadCount() : last - first - 1;
+			for (size_t i = 0; i < helpers; i++)
+				pool->Submit([job]() { job->Run(); });
+
+			job->Run();
+			job->Done.Wait();
+		}
+
+		void updateRoot()
+		{
+			// Serialized little-endian, so roots compare across platforms
+			uint8_t buffer[64 * 8];
+			XXHash::XXH3State state;
+			writeLittleEndian(buffer, mSize);
+			writeLittleEndian(buffer + 8, mLeafSize);
+			state.Update(buffer, 16);
+
+			for (size_t i = 0; i < mLeaves.size(); i += 64)
+			{
+				const size_t count = mLeaves.size() - i < 64 ? mLeaves.size() - i : 64;
+				for (size_t j = 0; j < count; j++)
+					writeLittleEndian(buffer + 8 * j, mLeaves[i + j]);
+
+				state.Update(buffer, 8 * count);
+			}
+
+			mRoot = state.Digest();
+		}
+
+		void build(const void *data, size_t size, ThreadPool *pool)
+		{
+			mSize = size;
+			mLeaves.assign(getLeafCount(size), 0);
+			hashLeaves(static_cast<const uint8_t *>(data), 0, mLeaves.size(), pool);
+			updateRoot();
+		}
+
+		void update(const void *data, size_t size, size_t offset, size_t length, ThreadPool *pool)
+		{
+			const size_t oldCount = mLeaves.size();
+			const bool resized = size != mSize;
+			mSize = size;
+			mLeaves.resize(getLeafCount(size), 0);
+
+			size_t first = offset / mLeafSize;
+			size_t last = length == 0 ? first : getLeafCount(static_cast<uint64_t>(offset) + length);
+
+			// A new size changes the old last leaf and everything after it
+			if (resized)
+			{
+				const size_t lastKept = oldCount < mLeaves.size() ? oldCount : mLeaves.size();
+				if (lastKept == 0)
+					first = 0;
+				else if (lastKept - 1 < first)
+					first = lastKept - 1;
+
+				last = mLeaves.size();
+			}
+
+			if (last > mLeaves.size())
+				last = mLeaves.size();
+
+			if (first < last)
+				hashLeaves(static_cast<const uint8_t *>(data), first, last, pool);
+
+			updateRoot();
+		}
+
+	public:
+		static constexpr size_t kDefaultLeafSize = 4 * 1024 * 1024;
+
+		// Leaves should be large enough that hashing one costs far more than handing
+		// it to a thread
+		explicit HashTree(size_t leafSize = kDefaultLeafSize)
+			: mLeafSize(leafSize == 0 ? kDefaultLeafSize : leafSize), mSize(0), mRoot(0)
+		{
+			updateRoot();
+		}
+
+		void Build(const void *data, size_t size)
+		{
+			build(data, size, nullptr);
+		}
+
+		void Build(const void *data, size_t size, ThreadPool &pool)
+		{
+			build(data, size, &pool);
+		}
+
+		// The file is mapped, so it has to be a regular file that fits in the
+		// address space. Returns false if it cannot be mapped.
+		bool BuildFile(const std::string &path)
+		{
+			MappedFile file;
+			if (!file.Open(path))
+				return false;
+
+			build(file.GetData(), file.GetSize(), nullptr);
+			return true;
+		}
+
+		bool BuildFile(const std::string &path, ThreadPool &pool)
+		{
+			MappedFile file;
+			if (!file.Open(path))
+				return false;
+
+			build(file.GetData(), file.GetSize(), &pool);
+			return true;
+		}
+
+		// Rehashes the leaves overlapping [offset, offset + length) of the new data,
+		// plus the end of the data if its size changed
+		void Update(const void *data, size_t size, size_t offset, size_t length)
+		{
+			update(data, size, offset, length, nullptr);
+		}
+
+		void Update(const void *data, size_t size, size_t offset, size_t length, ThreadPool &pool)
+		{
+			update(data, size, offset, length, &pool);
+		}
+
+		// Indices of the leaves that differ from the other tree's, including the ones
+		// only one of them has. Both need the same leaf size.
+		std::vector<size_t> GetChangedLeaves(const HashTree &other) const
+		{
+			std::vector<size_t> changed;
+			const size_t count = mLeaves.size() > other.mLeaves.size() ? mLeaves.size() : other.mLeaves.size();
+			for (size_t i = 0; i < count; i++)
+				if (i >= mLeaves.size() || i >= other.mLeaves.size() || mLeaves[i] != other.mLeaves[i])
+					changed.push_back(i);
+
+			return changed;
+		}
+
+		uint64_t GetRoot() const
+		{
+			return mRoot;
+		}
+
+		const std::vector<uint64_t> &GetLeaves() const
+		{
+			return mLeaves;
+		}
+
+		size_t GetLeafSize() const
+		{
+			return mLeafSize;
+		}
+
+		uint64_t GetSize() const
+		{
+			return mSize;
+		}
+	};
+}
+
+#endif // indigo_hash_tree_hpp_
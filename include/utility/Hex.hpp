@@ -0,0 +1,247 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_hex_hpp_
+#define indigo_hex_hpp_
+
+// Required libraries
+#include "../core/Cpu.hpp"
+#include <string>
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// Hexadecimal text for binary data, two characters per byte in memory order.
+	// Whole blocks are converted in SSE2 or AVX2 registers, so a 32-byte digest is
+	// a couple of instructions either way. Decoding accepts both cases and rejects
+	// anything that is not a hex digit. Nothing is allocated unless a std::string
+	// is asked for.
+	// Example:
+	//    char text[64];
+	//    Hex::Encode(digest.data(), 32, text);
+	//    if (!Hex::Decode(text, sizeof(text), digest.data()))
+	//        ...
+	class Hex
+	{
+		static constexpr char kLowerDigits[] = "0123456789abcdef";
+		static constexpr char kUpperDigits[] = "0123456789ABCDEF";
+
+		// Value of a hex digit, or -1
+		static int decodeDigit(char character)
+		{
+			if (character >= '0' && character <= '9')
+				return character - '0';
+
+			const char lower = static_cast<char>(character | 0x20);
+			if (lower >= 'a' && lower <= 'f')
+				return lower - 'a' + 10;
+
+			return -1;
+		}
+
+#if defined(INDIGO_SSE2)
+		// '0' + nibble, moved up to the letters for nibbles above 9
+		static __m128i encodeNibblesSse2(__m128i nibbles, __m128i letterOffset)
+		{
+			const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), letterOffset);
+			return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+		}
+
+		// Returns the characters for the low 8 bytes in the first register and for
+		// the high 8 bytes in the second
+		static void encodeSse2(__m128i value, __m128i letterOffset, __m128i &first, __m128i &second)
+		{
+			const __m128i mask = _mm_set1_epi8(0x0f);
+			const __m128i high = encodeNibblesSse2(_mm_and_si128(_mm_srli_epi16(value, 4), mask), letterOffset);
+			const __m128i low = encodeNibblesSse2(_mm_and_si128(value, mask), letterOffset);
+			first = _mm_unpacklo_epi8(high, low);
+			second = _mm_unpackhi_epi8(high, low);
+		}
+
+		// Decodes 16 characters into the low 8 bytes, clearing valid for anything
+		// that is not a hex digit
+		static __m128i decodeSse2(__m128i text, __m128i &valid)
+		{
+			// Characters below the base wrap around, so one unsigned compare checks both ends
+			const __m128i digits = _mm_sub_epi8(text, _mm_set1_epi8('0'));
+			const __m128i letters = _mm_sub_epi8(_mm_or_si128(text, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+			const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+			const __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letters, _mm_set1_epi8(5)), letters);
+			valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isLetter));
+
+			const __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, digits), _mm_and_si128(isLetter, _mm_add_epi8(letters, _mm_set1_epi8(10))));
+			// First character of each pair is the high nibble
+			const __m128i bytes = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(nibbles, 8));
+			return _mm_packus_epi16(bytes, bytes);
+		}
+#endif
+
+#if defined(INDIGO_X86)
+		INDIGO_TARGET("avx2")
+		static size_t encodeAvx2(const uint8_t *data, size_t size, char *output, bool upperCase)
+		{
+			const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(upperCase ? kUpperDigits : kLowerDigits)));
+			const __m256i mask = _mm256_set1_epi8(0x0f);
+			size_t i = 0;
+			for (; i + 32 <= size; i += 32, output += 64)
+			{
+				const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+				const __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(value, 4), mask));
+				const __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(value, mask));
+
+				// The unpacks work within each 128-bit half, so put the halves back in order
+				const __m256i first = _mm256_unpacklo_epi8(high, low);
+				const __m256i second = _mm256_unpackhi_epi8(high, low);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(output), _mm256_permute2x128_si256(first, second, 0x20));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(output + 32), _mm256_permute2x128_si256(first, second, 0x31));
+			}
+
+			return i;
+		}
+
+		INDIGO_TARGET("avx2")
+		static size_t decodeAvx2(const char *text, size_t size, uint8_t *output, bool &success)
+		{
+			__m256i valid = _mm256_set1_epi8(-1);
+			size_t i = 0;
+			for (; i + 32 <= size; i += 32)
+			{
+				const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + 2 * i));
+				const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + 2 * i + 32));
+				const __m256i nibbles[2] = { first, second };
+				__m256i bytes[2];
+				for (size_t j = 0; j < 2; j++)
+				{
+					const __m256i digits = _mm256_sub_epi8(nibbles[j], _mm256_set1_epi8('0'));
+					const __m256i letters = _mm256_sub_epi8(_mm256_or_si256(nibbles[j], _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+					const __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, _mm256_set1_epi8(9)), digits);
+					const __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letters, _mm256_set1_epi8(5)), letters);
+					valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isLetter));
+
+					const __m256i values = _mm256_or_si256(_mm256_and_si256(isDigit, digits), _mm256_and_si256(isLetter, _mm256_add_epi8(letters, _mm256_set1_epi8(10))));
+					// Multiplies the high nibble by 16 and adds the low one
+					bytes[j] = _mm256_maddubs_epi16(values, _mm256_set1_epi16(0x0110));
+				}
+
+				// The pack interleaves the 128-bit halves, so the middle quarters swap back
+				const __m256i packed = _mm256_packus_epi16(bytes[0], bytes[1]);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+
+			success = _mm256_movemask_epi8(valid) == -1;
+			return i;
+		}
+#endif
+
+	public:
+		// Writes 2 * size characters, without a terminator
+		static void Encode(const void *data, size_t size, char *output, bool upperCase = false)
+		{
+			const uint8_t *bytes = static_cast<const uint8_t *>(data);
+			size_t i = 0;
+
+#if defined(INDIGO_X86)
+			if (size >= 32 && Cpu::HasFeature(Cpu::kFeature_Avx2))
+				i = encodeAvx2(bytes, size, output, upperCase);
+#endif
+#if defined(INDIGO_SSE2)
+			const __m128i letterOffset = _mm_set1_epi8(static_cast<char>((upperCase ? 'A' : 'a') - '0' - 10));
+			for (; i + 16 <= size; i += 16)
+			{
+				__m128i first, second;
+				encodeSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i)), letterOffset, first, second);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(output + 2 * i), first);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(output + 2 * i + 16), second);
+			}
+
+			if (i + 8 <= size)
+			{
+				__m128i first, second;
+				encodeSse2(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(bytes + i)), letterOffset, first, second);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(output + 2 * i), first);
+				i += 8;
+			}
+#endif
+
+			const char *digits = upperCase ? kUpperDigits : kLowerDigits;
+			for (; i < size; i++)
+			{
+				output[2 * i] = digits[bytes[i] >> 4];
+				output[2 * i + 1] = digits[bytes[i] & 0x0f];
+			}
+		}
+
+		static std::string Encode(const void *data, size_t size, bool upperCase = false)
+		{
+			std::string result(2 * size, '\0');
+			Encode(data, size, result.data(), upperCase);
+			return result;
+		}
+
+		// Writes size / 2 bytes. Returns false if the size is odd or a character
+		// is not a hex digit, in which case the output is left partly written.
+		static bool Decode(const char *text, size_t size, void *output)
+		{
+			if (size % 2 != 0)
+				return false;
+
+			uint8_t *bytes = static_cast<uint8_t *>(output);
+			const size_t count = size / 2;
+			size_t i = 0;
+
+#if defined(INDIGO_X86)
+			if (count >= 32 && Cpu::HasFeature(Cpu::kFeature_Avx2))
+			{
+				bool success;
+				i = decodeAvx2(text, count, bytes, success);
+				if (!success)
+					return false;
+			}
+#endif
+#if defined(INDIGO_SSE2)
+			__m128i valid = _mm_set1_epi8(-1);
+			for (; i + 16 <= count; i += 16)
+			{
+				const __m128i first = decodeSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 2 * i)), valid);
+				const __m128i second = decodeSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 2 * i + 16)), valid);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(bytes + i), _mm_unpacklo_epi64(first, second));
+			}
+
+			if (i + 8 <= count)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(bytes + i), decodeSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(text + 2 * i)), valid));
+				i += 8;
+			}
+
+			if (_mm_movemask_epi8(valid) != 0xffff)
+				return false;
+#endif
+
+			for (; i < count; i++)
+			{
+				const int high = decodeDigit(text[2 * i]);
+				const int low = decodeDigit(text[2 * i + 1]);
+				if (high < 0 || low < 0)
+					return false;
+
+				bytes[i] = static_cast<uint8_t>(high << 4 | low);
+			}
+
+			return true;
+		}
+
+		static bool Decode(std::string_view text, void *output)
+		{
+			return Decode(text.data(), text.size(), output);
+		}
+	};
+}
+
+#endif // indigo_hex_hpp_
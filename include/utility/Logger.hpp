@@ -9,11 +9,15 @@
 #ifndef indigo_logger_hpp_
 #define indigo_logger_hpp_
 
+#include "../Platform.hpp"
+#include "../core/Format.hpp"
+#include "../core/Atom.hpp"
 #include <ostream>
 #include <iomanip>
+#include <string>
 #include <vector>
 #include <mutex>
-#include <stdarg.h>
+#include <ctime>
 
 namespace indigo
 {
@@ -31,6 +35,35 @@ namespace indigo
 		std::vector<std::ostream *> mStreams;
 		std::mutex mStreamsMutex;
 
+		static tm getLocalTime()
+		{
+			const time_t currentTime = time(nullptr);
+			tm localTime{};
+#if defined(OS_WIN)
+			localtime_s(&localTime, &currentTime);
+#else
+			localtime_r(&currentTime, &localTime);
+#endif
+			return localTime;
+		}
+
+		static const char *getTypeString(LogType type)
+		{
+			switch (type)
+			{
+			case kLogType_Error:
+				return "ERROR";
+			case kLogType_Warning:
+				return "WARNING";
+			case kLogType_Trace:
+				return "TRACE";
+			case kLogType_Info:
+				return "INFO";
+			default:
+				return "UNKN";
+			}
+		}
+
 	public:
 		Logger() : mLevel(kLogType_Error) {}
 		Logger(LogType level) : mLevel(level) {}
@@ -41,10 +74,7 @@ namespace indigo
 			mStreams.push_back(&stream);
 			mStreamsMutex.unlock();
 
-			time_t currentTime;
-			time(&currentTime);
-			tm localTime;
-			localtime_s(&localTime, &currentTime);
+			const tm localTime = getLocalTime();
 
 			stream << "==================================================" << std::endl;
 			stream << "Log created on "
@@ -81,56 +111,39 @@ namespace indigo
 			mLevel = level;
 		}
 
-		void Write(LogType type, const std::string &className, std::string format, ...)
+		// Formats the message with Formatter, see FormatString for the syntax
+		// Example:
+		//    logger.Write(kLogType_Info, "HttpClient", "Downloading %s (%zu bytes)", url, size);
+		template <typename... _TArgs>
+		void Write(LogType type, std::string_view className, FormatString<std::decay_t<_TArgs>...> format, const _TArgs &... arguments)
 		{
-			va_list arguments;
-			va_start(arguments, format);
-
-			const int length = _vscprintf(format.c_str(), arguments) + 1;
+			const tm localTime = getLocalTime();
 
-			std::vector<char> message;
-			message.resize(length);
-			fill(message.begin(), message.end(), 0);
-
-			vsprintf_s(message.data(), length, format.c_str(), arguments);
-
-			va_end(arguments);
-
-			const char *typeString;
-			switch (type)
-			{
-			case kLogType_Error:
-				typeString = "ERROR";
-				break;
-			case kLogType_Warning:
-				typeString = "WARNING";
-				break;
-			case kLogType_Trace:
-				typeString = "TRACE";
-				break;
-			case kLogType_Info:
-				typeString = "INFO";
-				break;
-			default:
-				typeString = "UNKN";
-			}
-
-			time_t currentTime;
-			time(&currentTime);
-			tm localTime{};
-			localtime_s(&localTime, &currentTime);
+			// Each thread keeps its line buffer, so logging does not allocate once warm
+			thread_local std::string line;
+			line.clear();
+			Formatter::FormatTo(line, "[%02d:%02d:%02d][%s:%s]: ", localTime.tm_hour, localTime.tm_min, localTime.tm_sec, getTypeString(type), className);
+			Formatter::FormatTo<_TArgs...>(line, format, arguments...);
+			line.push_back('\n');
 
 			mStreamsMutex.lock();
 			for (auto &stream : mStreams)
 			{
-				*stream << "[" << std::setw(2) << std::setfill('0') << localTime.tm_hour
-					<< ":" << std::setw(2) << std::setfill('0') << localTime.tm_min
-					<< ":" << std::setw(2) << std::setfill('0') << localTime.tm_sec
-					<< "][" << typeString << ":" << className.c_str()
-					<< "]: " << message.data() << std::endl;
+				stream->write(line.data(), static_cast<std::streamsize>(line.size()));
+				stream->flush();
 			}
 			mStreamsMutex.unlock();
 		}
+
+		// Class names that are logged often can be interned once
+		// Example:
+		//    static const Atom kCategory("HttpClient");
+		//    logger.Write(kLogType_Trace, kCategory, "Request finished");
+		template <typename... _TArgs>
+		void Write(LogType type, Atom className, FormatString<std::decay_t<_TArgs>...> format, const _TArgs &... arguments)
+		{
+			Write<_TArgs...>(type, className.GetString(), format, arguments...);
+		}
 	};
 }
 
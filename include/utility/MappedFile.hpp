@@ -0,0 +1,180 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_mapped_file_hpp_
+#define indigo_mapped_file_hpp_
+
+// Required libraries
+#include "../Platform.hpp"
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(OS_WIN)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace indigo
+{
+	// A read-only view of a whole file, mapped into memory instead of read into a
+	// buffer. The pages come straight from the OS file cache, so nothing is
+	// copied. Only regular files can be mapped; pipes and the like fail to open.
+	// Example:
+	//    MappedFile file;
+	//    if (file.Open(path))
+	//        Process(file.GetData(), file.GetSize());
+	class MappedFile
+	{
+		const uint8_t *mData;
+		size_t mSize;
+		bool mOpen;
+#if defined(OS_WIN)
+		HANDLE mFile;
+		HANDLE mMapping;
+#endif
+
+	public:
+		MappedFile() : mData(nullptr), mSize(0), mOpen(false)
+#if defined(OS_WIN)
+			, mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#endif
+		{ }
+
+		explicit MappedFile(const std::string &path) : MappedFile()
+		{
+			Open(path);
+		}
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		// Empty files open fine, with no data. The view is advised for a sequential
+		// read, which makes the OS read ahead aggressively.
+		bool Open(const std::string &path)
+		{
+			Close();
+
+#if defined(OS_WIN)
+			mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (mFile == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(mFile, &size) || static_cast<uint64_t>(size.QuadPart) > SIZE_MAX)
+			{
+				Close();
+				return false;
+			}
+
+			mSize = static_cast<size_t>(size.QuadPart);
+			if (mSize > 0)
+			{
+				mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mMapping == nullptr)
+				{
+					Close();
+					return false;
+				}
+
+				mData = static_cast<const uint8_t *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+				if (mData == nullptr)
+				{
+					Close();
+					return false;
+				}
+			}
+#else
+			const int descriptor = open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+				return false;
+
+			struct stat status;
+			if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || static_cast<uint64_t>(status.st_size) > SIZE_MAX)
+			{
+				close(descriptor);
+				return false;
+			}
+
+			mSize = static_cast<size_t>(status.st_size);
+			if (mSize > 0)
+			{
+				void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+				if (data == MAP_FAILED)
+				{
+					close(descriptor);
+					mSize = 0;
+					return false;
+				}
+
+				madvise(data, mSize, MADV_SEQUENTIAL);
+				mData = static_cast<const uint8_t *>(data);
+			}
+
+			// The mapping keeps the file alive
+			close(descriptor);
+#endif
+
+			mOpen = true;
+			return true;
+		}
+
+		void Close()
+		{
+#if defined(OS_WIN)
+			if (mData != nullptr)
+				UnmapViewOfFile(mData);
+
+			if (mMapping != nullptr)
+				CloseHandle(mMapping);
+
+			if (mFile != INVALID_HANDLE_VALUE)
+				CloseHandle(mFile);
+
+			mMapping = nullptr;
+			mFile = INVALID_HANDLE_VALUE;
+#else
+			if (mData != nullptr)
+				munmap(const_cast<uint8_t *>(mData), mSize);
+#endif
+
+			mData = nullptr;
+			mSize = 0;
+			mOpen = false;
+		}
+
+		bool IsOpen() const
+		{
+			return mOpen;
+		}
+
+		const uint8_t *GetData() const
+		{
+			return mData;
+		}
+
+		size_t GetSize() const
+		{
+			return mSize;
+		}
+	};
+}
+
+#endif // indigo_mapped_file_hpp_
@@ -0,0 +1,485 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_sha256_hpp_
+#define indigo_sha256_hpp_
+
+// Required libraries
+#include "../core/Cpu.hpp"
+#include "Digest.hpp"
+#include <cstring>
+#include <string_view>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// SHA-256 (FIPS 180-4). Blocks are compressed with the SHA extensions when the
+	// CPU has them, and with portable code otherwise. HashMany hashes several
+	// independent messages at once: without the SHA extensions it runs eight
+	// messages side by side in AVX2 registers, one per 32-bit lane.
+	// The object itself hashes incrementally, so a download can be verified while
+	// it arrives.
+	// Example:
+	//    Sha256 sha;
+	//    while (ReadChunk(chunk))
+	//        sha.Update(chunk.data(), chunk.size());
+	//    if (sha.Finalize() != expected)
+	//        ...
+	class Sha256
+	{
+	public:
+		static constexpr size_t kDigestSize = 32;
+		static constexpr size_t kBlockSize = 64;
+
+		typedef indigo::Digest<kDigestSize> Digest;
+		using Result = Digest;
+
+	private:
+		static constexpr size_t kLanes = 8;
+
+		uint32_t mState[8];
+		uint8_t mBuffer[kBlockSize];
+		size_t mBuffered;
+		uint64_t mSize;
+
+		alignas(16) static constexpr uint32_t kRoundConstants[64] =
+		{
+			0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+			0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+			0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+			0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+			0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+			0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+			0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+			0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+		};
+
+		static constexpr uint32_t kInitialState[8] =
+		{
+			0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+		};
+
+		static uint32_t readBigEndian(const uint8_t *data)
+		{
+			return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16)
+				| (static_cast<uint32_t>(data[2]) << 8) | data[3];
+		}
+
+		static void writeBigEndian(uint8_t *data, uint64_t value, size_t bytes)
+		{
+			for (size_t i = 0; i < bytes; i++)
+				data[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+		}
+
+		static uint32_t rotateRight(uint32_t value, int bits)
+		{
+			return (value >> bits) | (value << (32 - bits));
+		}
+
+		static void compressPortable(uint32_t *state, const uint8_t *data, size_t blocks)
+		{
+			for (; blocks > 0; blocks--, data += kBlockSize)
+			{
+				uint32_t schedule[64];
+				for (size_t i = 0; i < 16; i++)
+					schedule[i] = readBigEndian(data + 4 * i);
+
+				for (size_t i = 16; i < 64; i++)
+				{
+					const uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+					const uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+					schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+				}
+
+				uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+				uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+				for (size_t i = 0; i < 64; i++)
+				{
+					const uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+					const uint32_t choice = (e & f) ^ (~e & g);
+					const uint32_t temp1 = h + s1 + choice + kRoundConstants[i] + schedule[i];
+					const uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+					const uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+					h = g;
+					g = f;
+					f = e;
+					e = d + temp1;
+					d = c;
+					c = b;
+					b = a;
+					a = temp1 + s0 + majority;
+				}
+
+				state[0] += a;
+				state[1] += b;
+				state[2] += c;
+				state[3] += d;
+				state[4] += e;
+				state[5] += f;
+				state[6] += g;
+				state[7] += h;
+			}
+		}
+
+#if defined(INDIGO_X86)
+		// Four rounds. Message group g is current, previous is g - 1 and next g + 1;
+		// the schedule for later groups is built on the way, in place.
+		INDIGO_TARGET("sha,sse4.1,ssse3")
+		static void roundsShaNi(__m128i &state0, __m128i &state1, __m128i current, __m128i &previous, __m128i &next, size_t group)
+		{
+			__m128i message = _mm_add_epi32(current, _mm_load_si128(reinterpret_cast<const __m128i *>(kRoundConstants) + group));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+			if (group >= 3 && group <= 14)
+			{
+				next = _mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4));
+				next = _mm_sha256msg2_epu32(next, current);
+			}
+
+			message = _mm_shuffle_epi32(message, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+			if (group >= 1 && group <= 12)
+				previous = _mm_sha256msg1_epu32(previous, current);
+		}
+
+		INDIGO_TARGET("sha,sse4.1,ssse3")
+		static void compressShaNi(uint32_t *state, const uint8_t *data, size_t blocks)
+		{
+			const __m128i byteSwap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+			// The instructions want the state as ABEF and CDGH
+			__m128i temp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+			__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+			__m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+			state1 = _mm_blend_epi16(state1, temp, 0xF0);
+
+			for (; blocks > 0; blocks--, data += kBlockSize)
+			{
+				const __m128i saved0 = state0;
+				const __m128i saved1 = state1;
+
+				__m128i message[4];
+				for (size_t i = 0; i < 4; i++)
+					message[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data) + i), byteSwap);
+
+				for (size_t group = 0; group < 16; group += 4)
+				{
+					roundsShaNi(state0, state1, message[0], message[3], message[1], group);
+					roundsShaNi(state0, state1, message[1], message[0], message[2], group + 1);
+					roundsShaNi(state0, state1, message[2], message[1], message[3], group + 2);
+					roundsShaNi(state0, state1, message[3], message[2], message[0], group + 3);
+				}
+
+				state0 = _mm_add_epi32(state0, saved0);
+				state1 = _mm_add_epi32(state1, saved1);
+			}
+
+			temp = _mm_shuffle_epi32(state0, 0x1B);
+			state1 = _mm_shuffle_epi32(state1, 0xB1);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(temp, state1, 0xF0));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, temp, 8));
+		}
+
+		INDIGO_TARGET("avx2")
+		static __m256i rotateRightAvx2(__m256i value, int bits)
+		{
+			return _mm256_or_si256(_mm256_srli_epi32(value, bits), _mm256_slli_epi32(value, 32 - bits));
+		}
+
+		// Eight 32-bit words, one from each row, become eight rows of one word each
+		INDIGO_TARGET("avx2")
+		static void transpose(__m256i *rows)
+		{
+			__m256i low[8];
+			for (size_t i = 0; i < 8; i += 2)
+			{
+				low[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1]);
+				low[i + 1] = _mm256_unpackhi_epi32(rows[i], rows[i + 1]);
+			}
+
+			__m256i quad[8];
+			for (size_t i = 0; i < 8; i += 4)
+			{
+				quad[i] = _mm256_unpacklo_epi64(low[i], low[i + 2]);
+				quad[i + 1] = _mm256_unpackhi_epi64(low[i], low[i + 2]);
+				quad[i + 2] = _mm256_unpacklo_epi64(low[i + 1], low[i + 3]);
+				quad[i + 3] = _mm256_unpackhi_epi64(low[i + 1], low[i + 3]);
+			}
+
+			for (size_t i = 0; i < 4; i++)
+			{
+				rows[i] = _mm256_permute2x128_si256(quad[i], quad[i + 4], 0x20);
+				rows[i + 4] = _mm256_permute2x128_si256(quad[i], quad[i + 4], 0x31);
+			}
+		}
+
+		// One block for each of eight messages. state holds word i of every lane in
+		// state[i].
+		INDIGO_TARGET("avx2")
+		static void compressAvx2(__m256i *state, const uint8_t *const *blocks)
+		{
+			const __m256i byteSwap = _mm256_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL, 0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+			__m256i schedule[64];
+			for (size_t half = 0; half < 2; half++)
+			{
+				for (size_t lane = 0; lane < kLanes; lane++)
+					schedule[8 * half + lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(blocks[lane]) + half);
+
+				transpose(schedule + 8 * half);
+			}
+
+			for (size_t i = 0; i < 16; i++)
+				schedule[i] = _mm256_shuffle_epi8(schedule[i], byteSwap);
+
+			for (size_t i = 16; i < 64; i++)
+			{
+				const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotateRightAvx2(schedule[i - 15], 7), rotateRightAvx2(schedule[i - 15], 18)),
+					_mm256_srli_epi32(schedule[i - 15], 3));
+				const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotateRightAvx2(schedule[i - 2], 17), rotateRightAvx2(schedule[i - 2], 19)),
+					_mm256_srli_epi32(schedule[i - 2], 10));
+				schedule[i] = _mm256_add_epi32(_mm256_add_epi32(schedule[i - 16], s0), _mm256_add_epi32(schedule[i - 7], s1));
+			}
+
+			__m256i a = state[0], b = state[1], c = state[2], d = state[3];
+			__m256i e = state[4], f = state[5], g = state[6], h = state[7];
+			for (size_t i = 0; i < 64; i++)
+			{
+				const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotateRightAvx2(e, 6), rotateRightAvx2(e, 11)), rotateRightAvx2(e, 25));
+				const __m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+				const __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(choice, schedule[i])),
+					_mm256_set1_epi32(static_cast<int>(kRoundConstants[i])));
+				const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotateRightAvx2(a, 2), rotateRightAvx2(a, 13)), rotateRightAvx2(a, 22));
+				const __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+				h = g;
+				g = f;
+				f = e;
+				e = _mm256_add_epi32(d, temp1);
+				d = c;
+				c = b;
+				b = a;
+				a = _mm256_add_epi32(temp1, _mm256_add_epi32(s0, majority));
+			}
+
+			state[0] = _mm256_add_epi32(state[0], a);
+			state[1] = _mm256_add_epi32(state[1], b);
+			state[2] = _mm256_add_epi32(state[2], c);
+			state[3] = _mm256_add_epi32(state[3], d);
+			state[4] = _mm256_add_epi32(state[4], e);
+			state[5] = _mm256_add_epi32(state[5], f);
+			state[6] = _mm256_add_epi32(state[6], g);
+			state[7] = _mm256_add_epi32(state[7], h);
+		}
+
+		// Messages are handed to lanes as they become free, so short ones do not
+		// hold up the rest
+		INDIGO_TARGET("avx2")
+		static void hashManyAvx2(const void *const *data, const size_t *sizes, size_t count, Digest *digests)
+		{
+			struct Lane
+			{
+				const uint8_t *Data;
+				size_t Message;
+				size_t FullBlocks;
+				size_t Blocks;
+				size_t Next;
+				// The padded end of the message, one or two blocks
+				uint8_t Tail[2 * kBlockSize];
+			};
+
+			static const uint8_t idle[kBlockSize] = {};
+			Lane lanes[kLanes];
+			alignas(32) uint32_t words[8][kLanes];
+			size_t next = 0;
+			size_t active = 0;
+
+			auto start = [&](size_t index)
+			{
+				Lane &lane = lanes[index];
+				lane.Message = next++;
+				lane.Data = static_cast<const uint8_t *>(data[lane.Message]);
+				lane.FullBlocks = sizes[lane.Message] / kBlockSize;
+				lane.Next = 0;
+
+				const size_t rest = sizes[lane.Message] % kBlockSize;
+				const size_t tailBlocks = rest + 9 > kBlockSize ? 2 : 1;
+				memset(lane.Tail, 0, sizeof(lane.Tail));
+				if (rest > 0)
+					memcpy(lane.Tail, lane.Data + lane.FullBlocks * kBlockSize, rest);
+
+				lane.Tail[rest] = 0x80;
+				writeBigEndian(lane.Tail + tailBlocks * kBlockSize - 8, static_cast<uint64_t>(sizes[lane.Message]) * 8, 8);
+				lane.Blocks = lane.FullBlocks + tailBlocks;
+
+				for (size_t word = 0; word < 8; word++)
+					words[word][index] = kInitialState[word];
+			};
+
+			for (size_t i = 0; i < kLanes; i++)
+			{
+				if (next < count)
+				{
+					start(i);
+					active |= static_cast<size_t>(1) << i;
+				}
+				else
+					lanes[i].Data = nullptr;
+			}
+
+			__m256i state[8];
+			for (size_t word = 0; word < 8; word++)
+				state[word] = _mm256_load_si256(reinterpret_cast<const __m256i *>(words[word]));
+
+			while (active != 0)
+			{
+				const uint8_t *blocks[kLanes];
+				for (size_t i = 0; i < kLanes; i++)
+				{
+					const Lane &lane = lanes[i];
+					if ((active & (static_cast<size_t>(1) << i)) == 0)
+						blocks[i] = idle;
+					else if (lane.Next < lane.FullBlocks)
+						blocks[i] = lane.Data + lane.Next * kBlockSize;
+					else
+						blocks[i] = lane.Tail + (lane.Next - lane.FullBlocks) * kBlockSize;
+				}
+
+				compressAvx2(state, blocks);
+
+				bool finished = false;
+				for (size_t i = 0; i < kLanes; i++)
+					if ((active & (static_cast<size_t>(1) << i)) != 0 && ++lanes[i].Next == lanes[i].Blocks)
+						finished = true;
+
+				if (!finished)
+					continue;
+
+				for (size_t word = 0; word < 8; word++)
+					_mm256_store_si256(reinterpret_cast<__m256i *>(words[word]), state[word]);
+
+				for (size_t i = 0; i < kLanes; i++)
+				{
+					if ((active & (static_cast<size_t>(1) << i)) == 0 || lanes[i].Next != lanes[i].Blocks)
+						continue;
+
+					for (size_t word = 0; word < 8; word++)
+						writeBigEndian(digests[lanes[i].Message].data() + 4 * word, words[word][i], 4);
+
+					if (next < count)
+						start(i);
+					else
+						active &= ~(static_cast<size_t>(1) << i);
+				}
+
+				for (size_t word = 0; word < 8; word++)
+					state[word] = _mm256_load_si256(reinterpret_cast<const __m256i *>(words[word]));
+			}
+		}
+#endif
+
+		static void compress(uint32_t *state, const uint8_t *data, size_t blocks)
+		{
+#if defined(INDIGO_X86)
+			if (Cpu::HasFeature(Cpu::kFeature_Sha) && Cpu::HasFeature(Cpu::kFeature_Sse41))
+				return compressShaNi(state, data, blocks);
+#endif
+			compressPortable(state, data, blocks);
+		}
+
+	public:
+		Sha256()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			memcpy(mState, kInitialState, sizeof(mState));
+			mBuffered = 0;
+			mSize = 0;
+		}
+
+		void Update(const void *data, size_t size)
+		{
+			auto *input = static_cast<const uint8_t *>(data);
+			mSize += size;
+
+			if (mBuffered > 0)
+			{
+				const size_t fill = kBlockSize - mBuffered < size ? kBlockSize - mBuffered : size;
+				memcpy(mBuffer + mBuffered, input, fill);
+				mBuffered += fill;
+				input += fill;
+				size -= fill;
+
+				if (mBuffered < kBlockSize)
+					return;
+
+				compress(mState, mBuffer, 1);
+				mBuffered = 0;
+			}
+
+			if (size >= kBlockSize)
+			{
+				compress(mState, input, size / kBlockSize);
+				input += size - size % kBlockSize;
+				size %= kBlockSize;
+			}
+
+			if (size > 0)
+				memcpy(mBuffer, input, size);
+			mBuffered = size;
+		}
+
+		void Update(std::string_view data)
+		{
+			Update(data.data(), data.size());
+		}
+
+		// Does not change the state, more data can still be added
+		Digest Finalize() const
+		{
+			uint32_t state[8];
+			memcpy(state, mState, sizeof(state));
+
+			uint8_t tail[2 * kBlockSize] = {};
+			memcpy(tail, mBuffer, mBuffered);
+			tail[mBuffered] = 0x80;
+			const size_t blocks = mBuffered + 9 > kBlockSize ? 2 : 1;
+			writeBigEndian(tail + blocks * kBlockSize - 8, mSize * 8, 8);
+			compress(state, tail, blocks);
+
+			Digest digest;
+			for (size_t i = 0; i < 8; i++)
+				writeBigEndian(digest.data() + 4 * i, state[i], 4);
+
+			return digest;
+		}
+
+		static Digest Compute(const void *data, size_t size)
+		{
+			Sha256 sha;
+			sha.Update(data, size);
+			return sha.Finalize();
+		}
+
+		// Hashes count independent messages into digests[0..count)
+		static void HashMany(const void *const *data, const size_t *sizes, size_t count, Digest *digests)
+		{
+#if defined(INDIGO_X86)
+			// The SHA extensions beat eight AVX2 lanes
+			if (count > 1 && !Cpu::HasFeature(Cpu::kFeature_Sha) && Cpu::HasFeature(Cpu::kFeature_Avx2))
+				return hashManyAvx2(data, sizes, count, digests);
+#endif
+			for (size_t i = 0; i < count; i++)
+				digests[i] = Compute(data[i], sizes[i]);
+		}
+	};
+}
+
+#endif // indigo_sha256_hpp_
@@ -0,0 +1,729 @@
+/*
+*   This file is part of the Indigo library.
+*
+*   This program is licensed under the GNU General
+*   Public License. To view the full license, check
+*   LICENSE in the project root.
+*/
+
+#ifndef indigo_xxhash_hpp_
+#define indigo_xxhash_hpp_
+
+// Required libraries
+#include "../core/Cpu.hpp"
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace indigo
+{
+	// XXH64 and XXH3 (64-bit), the non-cryptographic hashes by Yann Collet. The
+	// results match the reference implementation for every input and seed, so they
+	// can be compared with hashes computed elsewhere.
+	// XXH3 reads 64 bytes per step into eight independent accumulators, which maps
+	// onto SSE2 and AVX2 registers; inputs up to 240 bytes skip the accumulators
+	// and are mixed with a few multiplies instead. XXH64 is the older, portable one.
+	// Example:
+	//    const uint64_t key = XXHash::XXH3_64(data, size);
+	//    ...
+	//    XXHash::XXH3State state;
+	//    while (ReadChunk(chunk))
+	//        state.Update(chunk.data(), chunk.size());
+	//    const uint64_t hash = state.Digest();
+	class XXHash
+	{
+		static constexpr uint32_t kPrime32_1 = 0x9E3779B1;
+		static constexpr uint32_t kPrime32_2 = 0x85EBCA77;
+		static constexpr uint32_t kPrime32_3 = 0xC2B2AE3D;
+		static constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87;
+		static constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4F;
+		static constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9;
+		static constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63;
+		static constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5;
+		static constexpr uint64_t kPrimeMx1 = 0x165667919E3779F9;
+		static constexpr uint64_t kPrimeMx2 = 0x9FB21C651E98DF25;
+
+		static constexpr size_t kSecretSize = 192;
+		static constexpr size_t kStripeSize = 64;
+		// Each stripe moves 8 bytes further into the secret
+		static constexpr size_t kStripesPerBlock = (kSecretSize - kStripeSize) / 8;
+		static constexpr size_t kBlockSize = kStripeSize * kStripesPerBlock;
+		static constexpr size_t kMidSizeMax = 240;
+
+		static const uint8_t *getSecret()
+		{
+			alignas(64) static const uint8_t secret[kSecretSize] =
+			{
+				0xB8, 0xFE, 0x6C, 0x39, 0x23, 0xA4, 0x4B, 0xBE, 0x7C, 0x01, 0x81, 0x2C, 0xF7, 0x21, 0xAD, 0x1C,
+				0xDE, 0xD4, 0x6D, 0xE9, 0x83, 0x90, 0x97, 0xDB, 0x72, 0x40, 0xA4, 0xA4, 0xB7, 0xB3, 0x67, 0x1F,
+				0xCB, 0x79, 0xE6, 0x4E, 0xCC, 0xC0, 0xE5, 0x78, 0x82, 0x5A, 0xD0, 0x7D, 0xCC, 0xFF, 0x72, 0x21,
+				0xB8, 0x08, 0x46, 0x74, 0xF7, 0x43, 0x24, 0x8E, 0xE0, 0x35, 0x90, 0xE6, 0x81, 0x3A, 0x26, 0x4C,
+				0x3C, 0x28, 0x52, 0xBB, 0x91, 0xC3, 0x00, 0xCB, 0x88, 0xD0, 0x65, 0x8B, 0x1B, 0x53, 0x2E, 0xA3,
+				0x71, 0x64, 0x48, 0x97, 0xA2, 0x0D, 0xF9, 0x4E, 0x38, 0x19, 0xEF, 0x46, 0xA9, 0xDE, 0xAC, 0xD8,
+				0xA8, 0xFA, 0x76, 0x3F, 0xE3, 0x9C, 0x34, 0x3F, 0xF9, 0xDC, 0xBB, 0xC7, 0xC7, 0x0B, 0x4F, 0x1D,
+				0x8A, 0x51, 0xE0, 0x4B, 0xCD, 0xB4, 0x59, 0x31, 0xC8, 0x9F, 0x7E, 0xC9, 0xD9, 0x78, 0x73, 0x64,
+				0xEA, 0xC5, 0xAC, 0x83, 0x34, 0xD3, 0xEB, 0xC3, 0xC5, 0x81, 0xA0, 0xFF, 0xFA, 0x13, 0x63, 0xEB,
+				0x17, 0x0D, 0xDD, 0x51, 0xB7, 0xF0, 0xDA, 0x49, 0xD3, 0x16, 0x55, 0x26, 0x29, 0xD4, 0x68, 0x9E,
+				0x2B, 0x16, 0xBE, 0x58, 0x7D, 0x47, 0xA1, 0xFC, 0x8F, 0xF8, 0xB8, 0xD1, 0x7A, 0xD0, 0x31, 0xCE,
+				0x45, 0xCB, 0x3A, 0x8F, 0x95, 0x16, 0x04, 0x28, 0xAF, 0xD7, 0xFB, 0xCA, 0xBB, 0x4B, 0x40, 0x7E
+			};
+
+			return secret;
+		}
+
+		static uint32_t swap32(uint32_t value)
+		{
+#if defined(_MSC_VER)
+			return _byteswap_ulong(value);
+#else
+			return __builtin_bswap32(value);
+#endif
+		}
+
+		static uint64_t swap64(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			return _byteswap_uint64(value);
+#else
+			return __builtin_bswap64(value);
+#endif
+		}
+
+		// Both hashes are defined on little-endian words
+		static uint32_t read32(const uint8_t *data)
+		{
+			uint32_t value;
+			memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			value = swap32(value);
+#endif
+			return value;
+		}
+
+		static uint64_t read64(const uint8_t *data)
+		{
+			uint64_t value;
+			memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			value = swap64(value);
+#endif
+			return value;
+		}
+
+		static void write64(uint8_t *data, uint64_t value)
+		{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+			value = swap64(value);
+#endif
+			memcpy(data, &value, sizeof(value));
+		}
+
+		static uint64_t rotateLeft(uint64_t value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		// Full 64x64 -> 128 bit product, with the halves xored together
+		static uint64_t multiplyFold(uint64_t left, uint64_t right)
+		{
+#if defined(__SIZEOF_INT128__)
+			const __uint128_t product = static_cast<__uint128_t>(left) * right;
+			return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			uint64_t high;
+			const uint64_t low = _umul128(left, right, &high);
+			return low ^ high;
+#else
+			const uint64_t lowLow = (left & 0xFFFFFFFF) * (right & 0xFFFFFFFF);
+			const uint64_t highLow = (left >> 32) * (right & 0xFFFFFFFF);
+			const uint64_t lowHigh = (left & 0xFFFFFFFF) * (right >> 32);
+			const uint64_t highHigh = (left >> 32) * (right >> 32);
+			const uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+			const uint64_t high = (highLow >> 32) + (cross >> 32) + highHigh;
+			const uint64_t low = (cross << 32) | (lowLow & 0xFFFFFFFF);
+			return low ^ high;
+#endif
+		}
+
+		// XXH64 helpers
+
+		static uint64_t round64(uint64_t accumulator, uint64_t input)
+		{
+			accumulator += input * kPrime64_2;
+			accumulator = rotateLeft(accumulator, 31);
+			return accumulator * kPrime64_1;
+		}
+
+		static uint64_t mergeRound64(uint64_t hash, uint64_t accumulator)
+		{
+			hash ^= round64(0, accumulator);
+			return hash * kPrime64_1 + kPrime64_4;
+		}
+
+		static uint64_t avalanche64(uint64_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= kPrime64_2;
+			hash ^= hash >> 29;
+			hash *= kPrime64_3;
+			hash ^= hash >> 32;
+			return hash;
+		}
+
+		// Mixes in the last 0 to 31 bytes
+		static uint64_t finalize64(uint64_t hash, const uint8_t *data, size_t size)
+		{
+			for (; size >= 8; size -= 8, data += 8)
+			{
+				hash ^= round64(0, read64(data));
+				hash = rotateLeft(hash, 27) * kPrime64_1 + kPrime64_4;
+			}
+
+			if (size >= 4)
+			{
+				hash ^= read32(data) * kPrime64_1;
+				hash = rotateLeft(hash, 23) * kPrime64_2 + kPrime64_3;
+				size -= 4;
+				data += 4;
+			}
+
+			for (; size > 0; size--, data++)
+			{
+				hash ^= *data * kPrime64_5;
+				hash = rotateLeft(hash, 11) * kPrime64_1;
+			}
+
+			return avalanche64(hash);
+		}
+
+		// XXH3 helpers
+
+		static uint64_t avalanche3(uint64_t hash)
+		{
+			hash ^= hash >> 37;
+			hash *= kPrimeMx1;
+			return hash ^ (hash >> 32);
+		}
+
+		static uint64_t mix16(const uint8_t *data, const uint8_t *secret, uint64_t seed)
+		{
+			return multiplyFold(read64(data) ^ (read64(secret) + seed), read64(data + 8) ^ (read64(secret + 8) - seed));
+		}
+
+		static uint64_t hashUpTo16(const uint8_t *data, size_t size, const uint8_t *secret, uint64_t seed)
+		{
+			if (size > 8)
+			{
+				const uint64_t low = read64(data) ^ ((read64(secret + 24) ^ read64(secret + 32)) + seed);
+				const uint64_t high = read64(data + size - 8) ^ ((read64(secret + 40) ^ read64(secret + 48)) - seed);
+				return avalanche3(size + swap64(low) + high + multiplyFold(low, high));
+			}
+
+			if (size >= 4)
+			{
+				seed ^= static_cast<uint64_t>(swap32(static_cast<uint32_t>(seed))) << 32;
+				const uint64_t input = read32(data + size - 4) + (static_cast<uint64_t>(read32(data)) << 32);
+				uint64_t hash = input ^ ((read64(secret + 8) ^ read64(secret + 16)) - seed);
+				hash ^= rotateLeft(hash, 49) ^ rotateLeft(hash, 24);
+				hash *= kPrimeMx2;
+				hash ^= (hash >> 35) + size;
+				hash *= kPrimeMx2;
+				return hash ^ (hash >> 28);
+			}
+
+			if (size > 0)
+			{
+				const uint32_t combined = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[size >> 1]) << 24)
+					| static_cast<uint32_t>(data[size - 1]) | (static_cast<uint32_t>(size) << 8);
+				return avalanche64(combined ^ ((read32(secret) ^ read32(secret + 4)) + seed));
+			}
+
+			return avalanche64(seed ^ read64(secret + 56) ^ read64(secret + 64));
+		}
+
+		static uint64_t hashUpTo128(const uint8_t *data, size_t size, const uint8_t *secret, uint64_t seed)
+		{
+			uint64_t hash = size * kPrime64_1;
+			if (size > 32)
+			{
+				if (size > 64)
+				{
+					if (size > 96)
+					{
+						hash += mix16(data + 48, secret + 96, seed);
+						hash += mix16(data + size - 64, secret + 112, seed);
+					}
+
+					hash += mix16(data + 32, secret + 64, seed);
+					hash += mix16(data + size - 48, secret + 80, seed);
+				}
+
+				hash += mix16(data + 16, secret + 32, seed);
+				hash += mix16(data + size - 32, secret + 48, seed);
+			}
+
+			hash += mix16(data, secret, seed);
+			hash += mix16(data + size - 16, secret + 16, seed);
+			return avalanche3(hash);
+		}
+
+		static uint64_t hashUpTo240(const uint8_t *data, size_t size, const uint8_t *secret, uint64_t seed)
+		{
+			uint64_t hash = size * kPrime64_1;
+			for (size_t i = 0; i < 8; i++)
+				hash += mix16(data + 16 * i, secret + 16 * i, seed);
+
+			hash = avalanche3(hash);
+			for (size_t i = 8; i < size / 16; i++)
+				hash += mix16(data + 16 * i, secret + 16 * (i - 8) + 3, seed);
+
+			hash += mix16(data + size - 16, secret + 136 - 17, seed);
+			return avalanche3(hash);
+		}
+
+		// Long inputs: one accumulator per 8 byte lane of a stripe. Stripe n of a block
+		// is keyed with the secret at offset 8 * n; blocks end with a scramble keyed
+		// with the last 64 bytes of the secret.
+
+		static void accumulateScalar(uint64_t *accumulators, const uint8_t *data, const uint8_t *secret, size_t stripes)
+		{
+			for (size_t stripe = 0; stripe < stripes; stripe++, data += kStripeSize, secret += 8)
+				for (size_t i = 0; i < 8; i++)
+				{
+					const uint64_t value = read64(data + 8 * i);
+					const uint64_t key = value ^ read64(secret + 8 * i);
+					accumulators[i ^ 1] += value;
+					accumulators[i] += (key & 0xFFFFFFFF) * (key >> 32);
+				}
+		}
+
+		static void scrambleScalar(uint64_t *accumulators, const uint8_t *secret)
+		{
+			for (size_t i = 0; i < 8; i++)
+			{
+				uint64_t accumulator = accumulators[i];
+				accumulator ^= accumulator >> 47;
+				accumulator ^= read64(secret + 8 * i);
+				accumulators[i] = accumulator * kPrime32_1;
+			}
+		}
+
+#if defined(INDIGO_SSE2)
+		static void accumulateSse2(uint64_t *accumulators, const uint8_t *data, const uint8_t *secret, size_t stripes)
+		{
+			__m128i lanes[4];
+			for (size_t i = 0; i < 4; i++)
+				lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(accumulators) + i);
+
+			for (size_t stripe = 0; stripe < stripes; stripe++, data += kStripeSize, secret += 8)
+				for (size_t i = 0; i < 4; i++)
+				{
+					const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data) + i);
+					const __m128i key = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + i));
+					// Low half of each lane times its high half
+					const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+					const __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+					lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+				}
+
+			for (size_t i = 0; i < 4; i++)
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(accumulators) + i, lanes[i]);
+		}
+
+		static void scrambleSse2(uint64_t *accumulators, const uint8_t *secret)
+		{
+			const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+			for (size_t i = 0; i < 4; i++)
+			{
+				__m128i lane = _mm_loadu_si128(reinterpret_cast<const __m128i *>(accumulators) + i);
+				lane = _mm_xor_si128(lane, _mm_srli_epi64(lane, 47));
+				lane = _mm_xor_si128(lane, _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret) + i));
+
+				// 64 x 32 bit multiply out of two 32 x 32 bit ones
+				const __m128i low = _mm_mul_epu32(lane, prime);
+				const __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(lane, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(accumulators) + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+			}
+		}
+#endif
+
+#if defined(INDIGO_X86)
+		INDIGO_TARGET("avx2")
+		static void accumulateAvx2(uint64_t *accumulators, const uint8_t *data, const uint8_t *secret, size_t stripes)
+		{
+			__m256i lanes[2];
+			for (size_t i = 0; i < 2; i++)
+				lanes[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(accumulators) + i);
+
+			for (size_t stripe = 0; stripe < stripes; stripe++, data += kStripeSize, secret += 8)
+				for (size_t i = 0; i < 2; i++)
+				{
+					const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data) + i);
+					const __m256i key = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+					const __m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+					const __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+					lanes[i] = _mm256_add_epi64(lanes[i], _mm256_add_epi64(product, swapped));
+				}
+
+			for (size_t i = 0; i < 2; i++)
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(accumulators) + i, lanes[i]);
+		}
+
+		INDIGO_TARGET("avx2")
+		static void scrambleAvx2(uint64_t *accumulators, const uint8_t *secret)
+		{
+			const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+			for (size_t i = 0; i < 2; i++)
+			{
+				__m256i lane = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(accumulators) + i);
+				lane = _mm256_xor_si256(lane, _mm256_srli_epi64(lane, 47));
+				lane = _mm256_xor_si256(lane, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret) + i));
+
+				const __m256i low = _mm256_mul_epu32(lane, prime);
+				const __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(lane, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(accumulators) + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+			}
+		}
+#endif
+
+		static void accumulate(uint64_t *accumulators, const uint8_t *data, const uint8_t *secret, size_t stripes)
+		{
+#if defined(INDIGO_X86)
+			if (Cpu::HasFeature(Cpu::kFeature_Avx2))
+				return accumulateAvx2(accumulators, data, secret, stripes);
+#endif
+#if defined(INDIGO_SSE2)
+			accumulateSse2(accumulators, data, secret, stripes);
+#else
+			accumulateScalar(accumulators, data, secret, stripes);
+#endif
+		}
+
+		static void scramble(uint64_t *accumulators, const uint8_t *secret)
+		{
+#if defined(INDIGO_X86)
+			if (Cpu::HasFeature(Cpu::kFeature_Avx2))
+				return scrambleAvx2(accumulators, secret);
+#endif
+#if defined(INDIGO_SSE2)
+			scrambleSse2(accumulators, secret);
+#else
+			scrambleScalar(accumulators, secret);
+#endif
+		}
+
+		static void initializeAccumulators(uint64_t *accumulators)
+		{
+			accumulators[0] = kPrime32_3;
+			accumulators[1] = kPrime64_1;
+			accumulators[2] = kPrime64_2;
+			accumulators[3] = kPrime64_3;
+			accumulators[4] = kPrime64_4;
+			accumulators[5] = kPrime32_2;
+			accumulators[6] = kPrime64_5;
+			accumulators[7] = kPrime32_1;
+		}
+
+		// Seeded long hashes use the default secret with the seed mixed in
+		static void deriveSecret(uint8_t *secret, uint64_t seed)
+		{
+			const uint8_t *base = getSecret();
+			for (size_t i = 0; i < kSecretSize; i += 16)
+			{
+				write64(secret + i, read64(base + i) + seed);
+				write64(secret + i + 8, read64(base + i + 8) - seed);
+			}
+		}
+
+		// The last stripe always ends at the end of the input, overlapping the one
+		// before if needed
+		static uint64_t finishLong(uint64_t *accumulators, const uint8_t *lastStripe, const uint8_t *secret, uint64_t size)
+		{
+			accumulate(accumulators, lastStripe, secret + kSecretSize - kStripeSize - 7, 1);
+
+			uint64_t hash = size * kPrime64_1;
+			for (size_t i = 0; i < 4; i++)
+				hash += multiplyFold(accumulators[2 * i] ^ read64(secret + 11 + 16 * i), accumulators[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+
+			return avalanche3(hash);
+		}
+
+		static uint64_t hashLong(const uint8_t *data, size_t size, const uint8_t *secret)
+		{
+			alignas(64) uint64_t accumulators[8];
+			initializeAccumulators(accumulators);
+
+			const size_t blocks = (size - 1) / kBlockSize;
+			for (size_t block = 0; block < blocks; block++)
+			{
+				accumulate(accumulators, data + block * kBlockSize, secret, kStripesPerBlock);
+				scramble(accumulators, secret + kSecretSize - kStripeSize);
+			}
+
+			const size_t stripes = (size - 1 - blocks * kBlockSize) / kStripeSize;
+			accumulate(accumulators, data + blocks * kBlockSize, secret, stripes);
+			return finishLong(accumulators, data + size - kStripeSize, secret, size);
+		}
+
+		static uint64_t hash3(const uint8_t *data, size_t size, uint64_t seed)
+		{
+			if (size <= 16)
+				return hashUpTo16(data, size, getSecret(), seed);
+
+			if (size <= 128)
+				return hashUpTo128(data, size, getSecret(), seed);
+
+			if (size <= kMidSizeMax)
+				return hashUpTo240(data, size, getSecret(), seed);
+
+			if (seed == 0)
+				return hashLong(data, size, getSecret());
+
+			alignas(64) uint8_t secret[kSecretSize];
+			deriveSecret(secret, seed);
+			return hashLong(data, size, secret);
+		}
+
+	public:
+		// Incremental XXH64, gives the same result as hashing all the data at once
+		class XXH64State
+		{
+			uint64_t mAccumulators[4];
+			uint8_t mBuffer[32];
+			size_t mBuffered;
+			uint64_t mSize;
+			uint64_t mSeed;
+
+		public:
+			explicit XXH64State(uint64_t seed = 0)
+			{
+				Reset(seed);
+			}
+
+			void Reset(uint64_t seed = 0)
+			{
+				mAccumulators[0] = seed + kPrime64_1 + kPrime64_2;
+				mAccumulators[1] = seed + kPrime64_2;
+				mAccumulators[2] = seed;
+				mAccumulators[3] = seed - kPrime64_1;
+				mBuffered = 0;
+				mSize = 0;
+				mSeed = seed;
+			}
+
+			void Update(const void *data, size_t size)
+			{
+				auto *input = static_cast<const uint8_t *>(data);
+				mSize += size;
+
+				if (mBuffered + size < sizeof(mBuffer))
+				{
+					if (size > 0)
+						memcpy(mBuffer + mBuffered, input, size);
+					mBuffered += size;
+					return;
+				}
+
+				if (mBuffered > 0)
+				{
+					const size_t fill = sizeof(mBuffer) - mBuffered;
+					memcpy(mBuffer + mBuffered, input, fill);
+					for (size_t i = 0; i < 4; i++)
+						mAccumulators[i] = round64(mAccumulators[i], read64(mBuffer + 8 * i));
+
+					input += fill;
+					size -= fill;
+					mBuffered = 0;
+				}
+
+				uint64_t v1 = mAccumulators[0], v2 = mAccumulators[1], v3 = mAccumulators[2], v4 = mAccumulators[3];
+				for (; size >= 32; size -= 32, input += 32)
+				{
+					v1 = round64(v1, read64(input));
+					v2 = round64(v2, read64(input + 8));
+					v3 = round64(v3, read64(input + 16));
+					v4 = round64(v4, read64(input + 24));
+				}
+
+				mAccumulators[0] = v1;
+				mAccumulators[1] = v2;
+				mAccumulators[2] = v3;
+				mAccumulators[3] = v4;
+
+				if (size > 0)
+					memcpy(mBuffer, input, size);
+				mBuffered = size;
+			}
+
+			// Does not change the state, more data can still be added
+			uint64_t Digest() const
+			{
+				uint64_t hash;
+				if (mSize >= 32)
+				{
+					hash = rotateLeft(mAccumulators[0], 1) + rotateLeft(mAccumulators[1], 7)
+						+ rotateLeft(mAccumulators[2], 12) + rotateLeft(mAccumulators[3], 18);
+					for (size_t i = 0; i < 4; i++)
+						hash = mergeRound64(hash, mAccumulators[i]);
+				}
+				else
+					hash = mSeed + kPrime64_5;
+
+				return finalize64(hash + mSize, mBuffer, mBuffered);
+			}
+		};
+
+		// Incremental XXH3. Short inputs are kept in the buffer and hashed as a whole
+		// at the end, so the result matches the one-shot hash at every size.
+		class XXH3State
+		{
+			static constexpr size_t kBufferSize = 4 * kStripeSize;
+
+			alignas(64) uint64_t mAccumulators[8];
+			alignas(64) uint8_t mSecret[kSecretSize];
+			alignas(64) uint8_t mBuffer[kBufferSize];
+			size_t mBuffered;
+			// Stripes of the current block already accumulated
+			size_t mStripes;
+			uint64_t mSize;
+			uint64_t mSeed;
+
+			static void consume(uint64_t *accumulators, size_t &stripesSoFar, const uint8_t *data, size_t stripes, const uint8_t *secret)
+			{
+				while (stripes > 0)
+				{
+					const size_t count = stripes < kStripesPerBlock - stripesSoFar ? stripes : kStripesPerBlock - stripesSoFar;
+					accumulate(accumulators, data, secret + stripesSoFar * 8, count);
+					data += count * kStripeSize;
+					stripes -= count;
+					stripesSoFar += count;
+
+					if (stripesSoFar == kStripesPerBlock)
+					{
+						scramble(accumulators, secret + kSecretSize - kStripeSize);
+						stripesSoFar = 0;
+					}
+				}
+			}
+
+		public:
+			explicit XXH3State(uint64_t seed = 0)
+			{
+				Reset(seed);
+			}
+
+			void Reset(uint64_t seed = 0)
+			{
+				initializeAccumulators(mAccumulators);
+				if (seed == 0)
+					memcpy(mSecret, getSecret(), kSecretSize);
+				else
+					deriveSecret(mSecret, seed);
+
+				mBuffered = 0;
+				mStripes = 0;
+				mSize = 0;
+				mSeed = seed;
+			}
+
+			void Update(const void *data, size_t size)
+			{
+				auto *input = static_cast<const uint8_t *>(data);
+				const uint8_t *end = input + size;
+				mSize += size;
+
+				// Always keep at least one byte back, the last stripe is handled by Digest
+				if (mBuffered + size <= kBufferSize)
+				{
+					if (size > 0)
+						memcpy(mBuffer + mBuffered, input, size);
+					mBuffered += size;
+					return;
+				}
+
+				if (mBuffered > 0)
+				{
+					const size_t fill = kBufferSize - mBuffered;
+					memcpy(mBuffer + mBuffered, input, fill);
+					input += fill;
+					consume(mAccumulators, mStripes, mBuffer, kBufferSize / kStripeSize, mSecret);
+					mBuffered = 0;
+				}
+
+				if (static_cast<size_t>(end - input) > kBufferSize)
+				{
+					// Stripes straight from the input, leaving at least one byte
+					const size_t stripes = (end - input - 1) / kStripeSize;
+					consume(mAccumulators, mStripes, input, stripes, mSecret);
+					input += stripes * kStripeSize;
+
+					// Digest may need the bytes before the buffer to make up a stripe
+					memcpy(mBuffer + kBufferSize - kStripeSize, input - kStripeSize, kStripeSize);
+				}
+
+				mBuffered = end - input;
+				memcpy(mBuffer, input, mBuffered);
+			}
+
+			// Does not change the state, more data can still be added
+			uint64_t Digest() const
+			{
+				if (mSize <= kMidSizeMax)
+					return hash3(mBuffer, static_cast<size_t>(mSize), mSeed);
+
+				alignas(64) uint64_t accumulators[8];
+				memcpy(accumulators, mAccumulators, sizeof(accumulators));
+
+				if (mBuffered >= kStripeSize)
+				{
+					size_t stripesSoFar = mStripes;
+					consume(accumulators, stripesSoFar, mBuffer, (mBuffered - 1) / kStripeSize, mSecret);
+					return finishLong(accumulators, mBuffer + mBuffered - kStripeSize, mSecret, mSize);
+				}
+
+				uint8_t lastStripe[kStripeSize];
+				const size_t catchUp = kStripeSize - mBuffered;
+				memcpy(lastStripe, mBuffer + kBufferSize - catchUp, catchUp);
+				memcpy(lastStripe + catchUp, mBuffer, mBuffered);
+				return finishLong(accumulators, lastStripe, mSecret, mSize);
+			}
+		};
+
+		static uint64_t XXH64(const void *data, size_t size, uint64_t seed = 0)
+		{
+			auto *input = static_cast<const uint8_t *>(data);
+			uint64_t hash;
+			if (size >= 32)
+			{
+				uint64_t v1 = seed + kPrime64_1 + kPrime64_2, v2 = seed + kPrime64_2, v3 = seed, v4 = seed - kPrime64_1;
+				const uint8_t *limit = input + size - 32;
+				do
+				{
+					v1 = round64(v1, read64(input));
+					v2 = round64(v2, read64(input + 8));
+					v3 = round64(v3, read64(input + 16));
+					v4 = round64(v4, read64(input + 24));
+					input += 32;
+				}
+				while (input <= limit);
+
+				hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+				hash = mergeRound64(hash, v1);
+				hash = mergeRound64(hash, v2);
+				hash = mergeRound64(hash, v3);
+				hash = mergeRound64(hash, v4);
+			}
+			else
+				hash = seed + kPrime64_5;
+
+			return finalize64(hash + size, input, size & 31);
+		}
+
+		static uint64_t XXH3_64(const void *data, size_t size, uint64_t seed = 0)
+		{
+			return hash3(static_cast<const uint8_t *>(data), size, seed);
+		}
+	};
+}
+
+#endif // indigo_xxhash_hpp_